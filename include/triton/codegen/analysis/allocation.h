@@ -3,6 +3,7 @@
 
 #include <map>
 #include <set>
+#include <vector>
 #include <iostream>
 #include "triton/codegen/analysis/liveness.h"
 
@@ -30,12 +31,21 @@ public:
   bool has_offset(const data_layout *x)    const { return offsets_.find(x) != offsets_.end(); }
   unsigned offset(const data_layout *x)    const { return offsets_.at(x); }
   unsigned allocated_size()        const { return allocated_size_; }
+  // lower bound on allocated_size(): bytes simultaneously live at the peak
+  unsigned peak_live_size()        const { return peak_live_size_; }
   // run
   void run(ir::module& mod);
 
+private:
+  static const unsigned alignment = 16;
+  static unsigned align(unsigned x) { return (x + alignment - 1) / alignment * alignment; }
+  size_t best_fit(const std::vector<shared_layout*>& order,
+                  std::map<const data_layout*, unsigned>& offsets);
+
 private:
   std::map<const data_layout*, unsigned> offsets_;
   size_t allocated_size_;
+  size_t peak_live_size_;
   // dependences
   liveness *liveness_;
 };
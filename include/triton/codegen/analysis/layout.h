@@ -16,6 +16,7 @@ namespace ir{
   class module;
   class instruction;
   class phi_node;
+  class reduce_inst;
 }
 
 namespace codegen{
@@ -226,6 +227,11 @@ public:
   int contig_per_thread(size_t k) { return nts_.at(k); }
 
   int per_thread(size_t k) { return contig_per_thread(k) * shape_[k] / shape_per_cta(k);}
+  // threads along axis `k`: distance between consecutive ones in the
+  // thread id, how many of them are in a warp, and how many warps they span
+  int lane_stride(size_t k);
+  int lanes_per_warp(size_t k);
+  int warps_along(size_t k) { return mts_.at(k) / lanes_per_warp(k); }
 private:
   // micro tile size. The size of a tile held by a thread block.
   std::vector<int> mts_;
@@ -302,6 +308,19 @@ class layouts {
   typedef ir::value* node_t;
   typedef std::map <node_t, std::set<node_t>> graph_t;
 
+public:
+  // lowering of reductions
+  enum reduce_strategy_t {
+    // shuffles within a warp
+    REDUCE_WARP,
+    // shuffles within warps, then one exchange between warps
+    REDUCE_WARP_SMEM,
+    // shuffles within quads of an mma layout
+    REDUCE_MMA,
+    // tree in shared memory
+    REDUCE_TREE
+  };
+
 private:
   // graph creation
   void connect(ir::value *x, ir::value *y);
@@ -316,7 +335,8 @@ private:
                          const std::vector<int>& axes,
                          const std::vector<unsigned>& shape,
                          ir::instruction* i,
-                         bool is_index = false);
+                         bool is_index = false,
+                         ir::type* ty = nullptr);
 
  public:
   // constructor
@@ -346,6 +366,12 @@ private:
 
   bool is_a100_mma(ir::instruction* i);
 
+  reduce_strategy_t reduce_strategy(ir::reduce_inst* i);
+  // whether `x` and `y` can exchange their partial results together
+  bool can_fuse(ir::reduce_inst* x, ir::reduce_inst* y);
+  // reductions lowered together with `i`, in program order
+  const std::vector<ir::reduce_inst*>& reduce_group(ir::reduce_inst* i) { return reduce_groups_.at(i); }
+
   // execution
   void run(ir::module &mod);
 
@@ -360,6 +386,7 @@ private:
   std::map<size_t, data_layout*> layouts_;
   std::map<ir::value*, size_t> tmp_;
   std::map<ir::value*, size_t> tmp_index_;
+  std::map<ir::reduce_inst*, std::vector<ir::reduce_inst*>> reduce_groups_;
 };
 
 }
@@ -0,0 +1,51 @@
+#ifndef TRITON_INCLUDE_IR_CODEGEN_REGISTERS_H
+#define TRITON_INCLUDE_IR_CODEGEN_REGISTERS_H
+
+#include <map>
+#include <set>
+
+namespace triton{
+
+namespace ir{
+  class value;
+  class instruction;
+  class function;
+  class module;
+}
+
+namespace codegen{
+namespace analysis{
+
+class layouts;
+
+// Estimates the number of 32-bit registers each thread needs, from the
+// values live at every program point and the number of elements each
+// thread owns in their layout. This runs before instruction selection, so
+// that configurations bound to spill can be rejected before paying for
+// LLVM and ptxas.
+class registers {
+private:
+  ir::value* root(ir::value* v);
+  unsigned temporaries(ir::instruction* i);
+  unsigned run(ir::function* fn);
+
+public:
+  registers(layouts *l, int num_warps): layouts_(l), num_warps_(num_warps) { }
+  // registers held by each thread for `v`
+  unsigned get(ir::value* v);
+  // maximum number of registers simultaneously live in a thread
+  unsigned max_live() const { return max_live_; }
+  // run
+  void run(ir::module &mod);
+
+private:
+  layouts* layouts_;
+  int num_warps_;
+  unsigned max_live_;
+};
+
+}
+}
+}
+
+#endif
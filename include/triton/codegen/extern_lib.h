@@ -1,12 +1,14 @@
 #ifndef _TRITON_CODE_GEN_EXTERN_LIB_H_
 #define _TRITON_CODE_GEN_EXTERN_LIB_H_
 
+#include <map>
 #include <memory>
 #include <string>
 
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
 
 namespace triton {
@@ -27,12 +29,14 @@ class ExternLib {
   virtual const std::string &path() const { return path_; }
 
   ///
-  /// \brief Load the library and return the module.
+  /// \brief Load the library and return the module. Bitcode is loaded
+  /// lazily, from a copy of the file kept in memory until this library
+  /// is destroyed.
   ///
   std::unique_ptr<llvm::Module> load(llvm::LLVMContext &ctx);
 
   ///
-  /// \brief Link the module into the given module.
+  /// \brief Link the functions of the module needed by the given module.
   ///
   void link(std::unique_ptr<llvm::Module> &llvm,
             std::unique_ptr<llvm::Module> &mod);
@@ -56,6 +60,7 @@ class ExternLib {
  private:
   std::string name_;
   std::string path_;
+  std::shared_ptr<llvm::MemoryBuffer> buffer_;
 };
 
 ///
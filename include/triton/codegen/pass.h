@@ -3,6 +3,9 @@
 
 
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 #include "extern_lib.h"
 
 namespace llvm{
@@ -29,12 +32,21 @@ namespace driver{
 namespace triton{
 namespace codegen{
 
+// Time spent in each pass, in ms, in the order they first ran.
+// Passes that run several times are accumulated into one entry
+typedef std::vector<std::pair<std::string, double>> pass_timings;
+
 // TODO:
 // There should be a proper pass manager there!
+// `opt_level` (0 to 3) is the optimization level of the LLVM passes
+// run on the generated module. Passes are timed into `timings`, if any.
+// When `max_regs` > 0 and more registers are estimated to be live, no
+// LLVM module is generated and nullptr is returned
 std::unique_ptr<llvm::Module> add_passes_to_emit_bin(
     ir::module &ir, llvm::LLVMContext &ctx, codegen::target *target,
-    int num_warps, int num_stages, int &shared_static,
-    const ExternLibMap &extern_libs);
+    int num_warps, int num_stages, int &shared_static, int &n_regs_estimate,
+    const ExternLibMap &extern_libs, int opt_level = 3,
+    pass_timings *timings = nullptr, int max_regs = 0);
 }
 }
 
@@ -8,6 +8,7 @@
 #include "triton/codegen/analysis/layout.h"
 #include "triton/codegen/extern_lib.h"
 #include <functional>
+#include <unordered_map>
 
 // forward
 namespace llvm{
@@ -78,6 +79,44 @@ struct distributed_axis {
   Value* thread_id;
 };
 
+struct indices_hash {
+  size_t operator()(const indices_t& idx) const;
+};
+
+/// Values of the elements of a block held by the current thread, stored
+/// densely in the order of its indices. Values with the same layout have the
+/// same indices, so elementwise instructions address their operands by
+/// position; lookups by indices go through a hash table built on first use.
+class block_values {
+public:
+  block_values(): idxs_(nullptr) { }
+  void bind(const std::vector<indices_t>* idxs);
+  bool bound() const { return idxs_ != nullptr; }
+  size_t size() const { return vals_.size(); }
+  Value*& at(size_t i) { assert(i < vals_.size()); return vals_[i]; }
+  Value*& operator[](const indices_t& idx);
+
+private:
+  const std::vector<indices_t>* idxs_;
+  std::vector<Value*> vals_;
+  std::unordered_map<indices_t, size_t, indices_hash> pos_;
+  /// elements outside of the indices (e.g., of values without any)
+  std::map<indices_t, Value*> others_;
+};
+
+/// Values of all the IR values of a function, bound to their indices
+class value_map {
+public:
+  value_map(const std::map<ir::value*, std::vector<indices_t>>& idxs): idxs_(idxs) { }
+  block_values& operator[](ir::value* v);
+  block_values& at(ir::value* v);
+  void clear() { vals_.clear(); }
+
+private:
+  const std::map<ir::value*, std::vector<indices_t>>& idxs_;
+  std::unordered_map<ir::value*, block_values> vals_;
+};
+
 class adder{
 public:
   adder(Builder** builder): builder_(builder) { }
@@ -113,6 +152,7 @@ private:
   void finalize_shared_layout(analysis::shared_layout*);
   void finalize_function(ir::function*);
   void finalize_phi_node(ir::phi_node*);
+  std::vector<std::vector<size_t>> io_vectors(ir::io_inst* x, ir::value* val, size_t nbits);
 
 private:
   Type *cvt(ir::type *ty);
@@ -186,7 +226,9 @@ private:
   void visit_trans_inst(ir::trans_inst*);
   void visit_sqrt_inst(ir::sqrt_inst*);
   Value* shfl_sync(Value* acc, int32_t i);
+  acc_fn_t reduce_acc_fn(ir::reduce_inst* x);
   void visit_reducend_inst_fast(ir::reduce_inst* x, acc_fn_t do_acc, Value *neutral);
+  void visit_reducend_inst_shfl(const std::vector<ir::reduce_inst*>& xs);
   void visit_reducend_inst(ir::reduce_inst* x, acc_fn_t do_acc, Value *neutral);
   void visit_reduce_inst(ir::reduce_inst*);
   void visit_select_inst(ir::select_inst*);
@@ -261,7 +303,7 @@ private:
   std::map<ir::value*, Value*> shmems_;
   std::map<ir::value*, Value*> shoffs_;
   std::map<ir::value*, std::vector<indices_t>> idxs_;
-  std::map<ir::value*, std::map<indices_t, Value*>> vals_;
+  value_map vals_;
   /// idx for multi-stage pipeline
   std::map<analysis::data_layout*, Value*> read_smem_idx_;
   std::map<analysis::data_layout*, Value*> write_smem_idx_;
@@ -30,6 +30,11 @@ private:
   void extract_io_use(ir::value *v, std::set<ir::io_inst*>& result);
   void extract_ld(ir::io_inst *i, std::map<int, std::vector<triton::ir::io_inst *> > &result);
   ir::value* rematerialize(ir::value *v, ir::builder& builder, std::map<ir::value*, ir::value*>& seen);
+  // cost model for global memory accesses performed by `i` on `val`,
+  // which lives in an MMA layout
+  double direct_io_cost(ir::io_inst* i, ir::value* val);
+  double converted_io_cost(ir::io_inst* i, ir::value* val);
+  bool is_direct_io_profitable(ir::io_inst* i, ir::value* val);
 
 public:
   coalesce(analysis::align* align, triton::codegen::analysis::layouts *layouts, bool has_sm80);
@@ -37,6 +42,26 @@ public:
   void run(ir::module &mod);
 
 private:
+  // Relative costs, in bytes of global memory traffic. Only their ratios
+  // matter. They are rough orders of magnitude for sm_80 (A100), not
+  // measurements of the generated code:
+  // - a byte moved through shared memory: 108 SMs x 128 B/clk x 1.41 GHz
+  //   give ~19 TB/s against ~1.6 TB/s of DRAM bandwidth. The 4x (rather
+  //   than 12x) ratio leaves room for bank conflicts in the conversion.
+  static constexpr double smem_byte_cost = 0.25;
+  // - an access instruction per thread: issuing a scalar 32-bit access
+  //   costs about as much as its traffic, which is why vectorized
+  //   accesses pay off in the first place.
+  static constexpr double mem_inst_cost = 4;
+  // - a CTA-wide barrier: a few tens of cycles during which the SM moves
+  //   ~10 bytes/clk of DRAM traffic (1.6 TB/s over 108 SMs at 1.41 GHz).
+  static constexpr double barrier_cost = 256;
+  // hardware constants: threads of a quad in the MMA layout, bytes of
+  // a global memory sector, and widest vector access
+  static constexpr unsigned quad_size = 4;
+  static constexpr unsigned sector_bytes = 32;
+  static constexpr unsigned max_vector_bytes = 16;
+
   bool has_sm80_;
   analysis::align* align_;
   analysis::layouts* layout_;
@@ -11,6 +11,7 @@ namespace triton {
 
 namespace ir {
   class module;
+  class function;
   class basic_block;
   class instruction;
   class masked_load_async_inst;
@@ -44,16 +45,22 @@ private:
   bool intersect(const val_set_t &X, const val_set_t &Y);
   bool check_safe_war(ir::instruction* i);
   int group_of(triton::ir::value *i, std::vector<triton::ir::value *> &async_write);
-  bool intersect_with(analysis::shared_layout* a_layout, analysis::shared_layout* b_layout);
+  void get_intervals(ir::value* v, std::vector<interval_t>& intervals);
+  bool intersect_with(ir::value* a, ir::value* b);
   val_set_t intersect_with(const val_set_t& as, const val_set_t& bs);
+  bool touches_shared(ir::instruction* i);
   void transfer(ir::basic_block *block, val_vec_t &async_write, val_set_t &sync_write, val_set_t &sync_read,
                 std::set<triton::ir::value *> &safe_war, bool &inserted, ir::builder &builder);
+  int coalesce(ir::basic_block *block);
 
 public:
   membar(analysis::liveness *liveness, analysis::layouts *layouts, analysis::allocation *alloc, 
          transform::prefetch *prefetch, target* tgt):
     liveness_(liveness), layouts_(layouts), alloc_(alloc), prefetch_(prefetch), tgt_(tgt) {}
   void run(ir::module &mod);
+  // barriers inserted by the dataflow analysis and barriers/async waits
+  // of the input found redundant and erased, per kernel
+  const std::map<ir::function*, std::pair<int, int>>& get_stats() const { return stats_; }
 
 private:
   analysis::liveness *liveness_;
@@ -62,6 +69,10 @@ private:
   transform::prefetch *prefetch_;
 
   target* tgt_;
+  std::map<ir::function*, std::pair<int, int>> stats_;
+  // synchronization inserted by this pass and still in the kernel
+  std::set<ir::instruction*> inserted_;
+  int num_removed_;
 };
 
 
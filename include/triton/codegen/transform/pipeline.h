@@ -5,6 +5,7 @@
 namespace triton {
 namespace ir {
 class module;
+class load_inst;
 }
 } // namespace triton
 
@@ -14,13 +15,22 @@ namespace transform {
 
 class pipeline {
 public:
-  pipeline(bool has_copy_async, int num_stages)
-      : has_copy_async_(has_copy_async), num_stages_(num_stages) {}
+  pipeline(bool has_copy_async, int num_stages, int num_warps = 4)
+      : has_copy_async_(has_copy_async), num_stages_(num_stages),
+        num_warps_(num_warps) {}
   void run(ir::module &module);
 
 private:
+  int get_num_stages(ir::load_inst *load, bool is_dot_operand);
+
+private:
+  // Upper bound on the number of bytes each thread may hold in registers
+  // for the prefetched copies of a single non-dot load.
+  static const int max_prefetch_bytes_per_thread = 64;
+
   bool has_copy_async_;
   int num_stages_;
+  int num_warps_;
 };
 
 } // namespace transform
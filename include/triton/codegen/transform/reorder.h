@@ -6,15 +6,29 @@ namespace triton {
 // forward declaration
 namespace ir {
 class module;
+class instruction;
 }
 
 namespace codegen{
 
+namespace analysis{
+class layouts;
+}
+
 namespace transform{
 
+// Moves reductions next to the ones they can be fused with
+// (see `layouts::reduce_group`)
 class reorder {
+private:
+  bool is_movable(ir::instruction* i);
+
 public:
+  reorder(analysis::layouts* layouts): layouts_(layouts) {}
   void run(ir::module& module);
+
+private:
+  analysis::layouts* layouts_;
 };
 
 }
@@ -62,7 +62,7 @@ public:
   static constant* get_zero_value_for_negation(type *ty);
   static constant* get(context &ctx, double v);
   static constant* get(type *ty, double v);
-  std::string repr() const { return std::to_string(value_); }
+  std::string repr() const;
   void accept(visitor* vst) { vst->visit_constant_fp(this); }
 
 private:
@@ -61,6 +61,7 @@ public:
   void set_metadata(ir::metadata::kind_t kind,
                     std::vector<unsigned> value)                           { metadatas_[kind] = value;}
   std::vector<unsigned> get_metadata(ir::metadata::kind_t kind)            { return metadatas_[kind];}
+  const std::map<ir::metadata::kind_t, std::vector<unsigned>>& get_metadatas() const { return metadatas_; }
   // cloning
   ir::instruction* clone() {
     ir::instruction* res = clone_impl();
@@ -169,6 +170,7 @@ public:
 
 private:
   std::string repr_impl() const;
+  std::string repr_op() const;
 
 protected:
   // Constructors
@@ -486,7 +488,7 @@ protected:
   }
   CACHE_MODIFIER cache_;
 
-  std::string get_volatile_repr() {
+  std::string get_volatile_repr() const {
     return is_volatile_ ? ".volatile" : "";
   }
   bool is_volatile_;
@@ -498,7 +500,9 @@ private:
 // unmasked load
 class unmasked_load_inst: public load_inst {
 private:
-  std::string repr_impl() const { return "unmasked_load" + get_cache_modifier_repr(); }
+  std::string repr_impl() const {
+    return "unmasked_load" + get_cache_modifier_repr() + get_eviction_policy_repr() + get_volatile_repr();
+  }
   unmasked_load_inst(value *ptr, load_inst::CACHE_MODIFIER cache, load_inst::EVICTION_POLICY eviction, bool is_volatile, const std::string &name, instruction *next);
 
 public:
@@ -514,7 +518,9 @@ public:
 // masked load
 class masked_load_inst: public load_inst {
 private:
-  std::string repr_impl() const { return "masked_load" + get_cache_modifier_repr(); }
+  std::string repr_impl() const {
+    return "masked_load" + get_cache_modifier_repr() + get_eviction_policy_repr() + get_volatile_repr();
+  }
   masked_load_inst(value *ptr, value *mask, value *false_value, load_inst::CACHE_MODIFIER cache, load_inst::EVICTION_POLICY eviction, bool is_volatile,
                    const std::string &name, instruction *next);
 
@@ -535,7 +541,9 @@ public:
 // masked load async
 class masked_load_async_inst: public load_inst {
 private:
-  std::string repr_impl() const { return "masked_load_async" + get_cache_modifier_repr(); }
+  std::string repr_impl() const {
+    return "masked_load_async" + get_cache_modifier_repr() + get_eviction_policy_repr();
+  }
   masked_load_async_inst(value *ptr, value *mask, value *false_value,
                          CACHE_MODIFIER cache, EVICTION_POLICY eviction,
                          const std::string &name, instruction *next);
@@ -569,7 +577,7 @@ public:
 // unmasked_store
 class unmasked_store_inst: public store_inst{
 private:
-  std::string repr_impl() const { return "unmasked_store"; }
+  std::string repr_impl() const { return "unmasked_store" + get_eviction_policy_repr(); }
   unmasked_store_inst(value *ptr, value *v, EVICTION_POLICY eviction, const std::string &name, instruction *next);
 
 public:
@@ -583,7 +591,7 @@ public:
 
 class masked_store_inst: public store_inst{
 private:
-  std::string repr_impl() const { return "masked_store"; }
+  std::string repr_impl() const { return "masked_store" + get_eviction_policy_repr(); }
   masked_store_inst(value *ptr, value *v, value *mask, EVICTION_POLICY eviction,
                     const std::string &name, instruction *next);
 
@@ -606,7 +614,7 @@ public:
 
 class insert_value_inst: public instruction {
 private:
-  std::string repr_impl() const { return "insertvalue"; }
+  std::string repr_impl() const { return "insertvalue(" + std::to_string(idx_) + ")"; }
   insert_value_inst(value *val, value *elt, size_t idx, const std::string &name, instruction *next);
 
 public:
@@ -623,7 +631,7 @@ private:
 
 class extract_value_inst: public instruction {
 private:
-  std::string repr_impl() const { return "extractvalue"; }
+  std::string repr_impl() const { return "extractvalue(" + std::to_string(idx_) + ")"; }
   extract_value_inst(value *val, size_t idx, const std::string &name, instruction *next);
 
 public:
@@ -768,7 +776,7 @@ public:
 class atomic_rmw_inst: public atomic_inst {
 private:
   atomic_rmw_inst(atomic_rmw_op_t op, value *ptr, value *val, value *msk, const std::string &name = "", instruction *next = nullptr);
-  std::string repr_impl() const { return "atomic_rmw"; }
+  std::string repr_impl() const;
   _TRITON_DEFINE_CLONE(atomic_rmw_inst)
   _TRITON_DEFINE_ACCEPT(atomic_rmw_inst)
 
@@ -858,7 +866,7 @@ public:
 
 private:
   dot_inst(value *A, value *B, value *C, TransT AT, TransT BT, bool allow_tf32, const std::string &name, instruction *next);
-  std::string repr_impl() const { return "dot"; }
+  std::string repr_impl() const;
   
 public:
   bool is_prefetched() const { return is_prefetched_; }
@@ -900,7 +908,7 @@ public:
 
 private:
   trans_inst(value *arg, const std::vector<int>& perm, const std::string& name, instruction* next);
-  std::string repr_impl() const { return "trans"; }
+  std::string repr_impl() const;
 
 public:
   static instruction* create(value *arg, const std::vector<int> &perm = {}, const std::string &name = "", instruction *next = nullptr);
@@ -938,7 +946,7 @@ private:
 
 private:
   reduce_inst(value* arg, op_t op, unsigned axis, const std::string& name, instruction* next);
-  std::string repr_impl() const { return "reduce"; }
+  std::string repr_impl() const;
   _TRITON_DEFINE_CLONE(reduce_inst)
   _TRITON_DEFINE_ACCEPT(reduce_inst)
 
@@ -1043,7 +1051,7 @@ private:
 };
 
 class prefetch_s_inst : public instruction {
-  std::string repr_impl() const { return "prefetch_s"; }
+  std::string repr_impl() const { return "prefetch_s(" + std::to_string(inc_) + ")"; }
   _TRITON_DEFINE_CLONE(prefetch_s_inst)
   _TRITON_DEFINE_ACCEPT(prefetch_s_inst)
   
@@ -1102,7 +1110,9 @@ class extern_elementwise_inst : public instruction {
                           type *dst_ty, const std::string &lib_name,
                           const std::string &extern_lib_path,
                           const std::string &symbol_name, instruction *next);
-  std::string repr_impl() const { return "extern_elementwise"; }
+  std::string repr_impl() const {
+    return "extern_elementwise(" + lib_name_ + ", " + lib_path_ + ", " + get_name() + ")";
+  }
   _TRITON_DEFINE_CLONE(extern_elementwise_inst)
   _TRITON_DEFINE_ACCEPT(extern_elementwise_inst)
 
@@ -1,100 +1,113 @@
 #include <algorithm>
 #include <climits>
+#include <cstdint>
+#include <functional>
 #include "triton/codegen/analysis/layout.h"
 #include "triton/codegen/analysis/allocation.h"
 #include "triton/codegen/analysis/liveness.h"
+#include "triton/ir/function.h"
+#include "triton/ir/module.h"
 #include "triton/ir/utils.h"
+#include "triton/tools/sys/getenv.hpp"
 
 namespace triton{
 namespace codegen{
 namespace analysis{
 
 
-void allocation::run(ir::module &mod) {
-  using std::max;
-  using std::min;
-  typedef std::multimap<unsigned, segment> triples_map_type;
-
-  std::vector<shared_layout*> I;
-  for(auto x: liveness_->get())
-    I.push_back(x.first);
-  std::vector<shared_layout*> J = I;
-
-  triples_map_type H;
-  H.insert({0, segment{0, INT_MAX}});
-
-  std::vector<shared_layout*> V;
-  std::map<shared_layout*, unsigned> starts;
-  while(!J.empty()){
-    auto h_it = H.begin();
-    unsigned w = h_it->first;
-    segment xh = h_it->second;
-    H.erase(h_it);
-    auto j_it = std::find_if(J.begin(), J.end(), [&](shared_layout* JJ){
-      segment xj = liveness_->get(JJ);
-      bool res = xj.intersect(xh);
-      for(auto val: H)
-        res = res && !val.second.intersect(xj);
-      return res;
-    });
-    if(j_it != J.end()){
-      unsigned size = (*j_it)->get_size();
-      segment xj = liveness_->get(*j_it);
-      starts[*j_it] = w;
-      H.insert({w + size, segment{max(xh.start, xj.start), min(xh.end, xj.end)}});
-      if(xh.start < xj.start)
-        H.insert({w, segment{xh.start, xj.end}});
-      if(xj.end < xh.end)
-        H.insert({w, segment{xj.start, xh.end}});
-      V.push_back(*j_it);
-      J.erase(j_it);
+// Best-fit placement of the layouts, taken in the given order: each buffer
+// goes into the smallest gap (after alignment) left between the buffers
+// already placed whose live ranges intersect its own, or on top of them
+// if no gap is large enough
+size_t allocation::best_fit(const std::vector<shared_layout*>& order,
+                            std::map<const data_layout*, unsigned>& offsets) {
+  size_t total = 0;
+  std::vector<shared_layout*> placed;
+  for(shared_layout* x: order){
+    segment live_x = liveness_->get(x);
+    unsigned size = x->get_size();
+    // address ranges that are unavailable to x
+    std::vector<std::pair<unsigned, unsigned>> used;
+    for(shared_layout* y: placed)
+      if(liveness_->get(y).intersect(live_x))
+        used.push_back({offsets[y], offsets[y] + y->get_size()});
+    std::sort(used.begin(), used.end());
+    unsigned best = UINT_MAX;
+    unsigned best_waste = UINT_MAX;
+    unsigned curr = 0;
+    for(const auto& range: used){
+      unsigned start = align(curr);
+      if(start + size <= range.first && range.first - curr - size < best_waste){
+        best = start;
+        best_waste = range.first - curr - size;
+      }
+      curr = std::max(curr, range.second);
     }
+    if(best == UINT_MAX)
+      best = align(curr);
+    offsets[x] = best;
+    total = std::max<size_t>(total, best + size);
+    placed.push_back(x);
   }
-  // Build interference graph
-  std::map<shared_layout*, std::set<shared_layout*>> interferences;
-  for(shared_layout* x: V)
-  for(shared_layout* y: V){
-    if(x == y)
-      continue;
-    unsigned X0 = starts[x], Y0 = starts[y];
-    unsigned NX = x->get_size();
-    unsigned NY = y->get_size();
-    segment XS = {X0, X0 + NX};
-    segment YS = {Y0, Y0 + NY};
-    if(liveness_->get(x).intersect(liveness_->get(y))
-        && XS.intersect(YS))
-      interferences[x].insert(y);
-  }
-  // Initialize colors
-  std::map<shared_layout*, int> colors;
-  for(shared_layout* X: V)
-    colors[X] = (X==V[0])?0:-1;
-  // First-fit graph coloring
-  std::vector<bool> available(V.size());
+  return total;
+}
+
+void allocation::run(ir::module &mod) {
+  std::vector<shared_layout*> V;
+  for(auto x: liveness_->get())
+    V.push_back(x.first);
+  // lower bound: largest number of bytes simultaneously live
+  peak_live_size_ = 0;
   for(shared_layout* x: V){
-    // Non-neighboring colors are available
-    std::fill(available.begin(), available.end(), true);
-    for(shared_layout* Y: interferences[x]){
-      int color = colors[Y];
-      if(color >= 0)
-        available[color] = false;
-    }
-    // Assigns first available color
-    auto It = std::find(available.begin(), available.end(), true);
-    colors[x] = std::distance(available.begin(), It);
+    size_t live = 0;
+    for(shared_layout* y: V)
+      if(liveness_->get(y).contains(liveness_->get(x).start))
+        live += y->get_size();
+    peak_live_size_ = std::max(peak_live_size_, live);
   }
-  // Finalize allocation
-  for(shared_layout* x: V){
-    unsigned Adj = 0;
-    for(shared_layout* y: interferences[x])
-      Adj = std::max<unsigned>(Adj, starts[y] + y->get_size());
-    offsets_[x] = starts[x] + colors[x] * Adj;
+  // try a few orderings and keep the tightest packing
+  auto by_size = [&](shared_layout* x, shared_layout* y){
+    if(x->get_size() != y->get_size())
+      return x->get_size() > y->get_size();
+    return liveness_->get(x).start < liveness_->get(y).start;
+  };
+  auto by_start = [&](shared_layout* x, shared_layout* y){
+    segment sx = liveness_->get(x), sy = liveness_->get(y);
+    if(sx.start != sy.start)
+      return sx.start < sy.start;
+    return x->get_size() > y->get_size();
+  };
+  auto by_area = [&](shared_layout* x, shared_layout* y){
+    segment sx = liveness_->get(x), sy = liveness_->get(y);
+    size_t ax = (size_t)x->get_size() * (sx.end - sx.start);
+    size_t ay = (size_t)y->get_size() * (sy.end - sy.start);
+    if(ax != ay)
+      return ax > ay;
+    return by_size(x, y);
+  };
+  std::vector<std::function<bool(shared_layout*, shared_layout*)>> orders = {by_size, by_start, by_area};
+  allocated_size_ = SIZE_MAX;
+  for(const auto& cmp: orders){
+    std::vector<shared_layout*> order = V;
+    std::stable_sort(order.begin(), order.end(), cmp);
+    std::map<const data_layout*, unsigned> offsets;
+    size_t size = best_fit(order, offsets);
+    if(size < allocated_size_){
+      allocated_size_ = size;
+      offsets_ = offsets;
+    }
+    if(allocated_size_ <= align(peak_live_size_))
+      break;
   }
-  // Save maximum size of induced memory space
-  allocated_size_ = 0;
-  for(shared_layout* x: V){
-    allocated_size_ = std::max<size_t>(allocated_size_, starts[x] + x->get_size());
-    // std::cout << "start: " << starts[x] << " | end: " << starts[x] + x->get_size() << std::endl;
+  // fragmentation report
+  if(!tools::getenv("TRITON_CODEGEN_STATS").empty()){
+    std::string name = mod.get_function_list().empty() ? "" : mod.get_function_list()[0]->get_name();
+    double frag = allocated_size_ ? 100. * (allocated_size_ - peak_live_size_) / allocated_size_ : 0.;
+    std::cerr << "allocation: " << name << ": "
+              << allocated_size_ << " bytes allocated, "
+              << peak_live_size_ << " bytes peak live, "
+              << V.size() << " buffer(s), "
+              << frag << "% fragmentation" << std::endl;
   }
 }
 
@@ -4,6 +4,7 @@
 #include "triton/codegen/analysis/axes.h"
 #include "triton/codegen/analysis/align.h"
 #include "triton/codegen/analysis/layout.h"
+#include "triton/ir/basic_block.h"
 #include "triton/ir/function.h"
 #include "triton/ir/module.h"
 #include "triton/ir/utils.h"
@@ -325,6 +326,17 @@ scanline_layout::scanline_layout(size_t num_warps,
     shape_per_cta_[d] = mts_[d]*nts_[d];
 }
 
+int scanline_layout::lane_stride(size_t k) {
+  int ret = 1;
+  for(size_t d = 0; order_[d] != (int)k; d++)
+    ret *= mts_[order_[d]];
+  return ret;
+}
+
+int scanline_layout::lanes_per_warp(size_t k) {
+  return std::max(1, std::min(mts_.at(k), 32 / lane_stride(k)));
+}
+
 
 /* -------------------------------- *
  *          Shared Layout           *
@@ -632,12 +644,42 @@ bool layouts::is_a100_mma(ir::instruction *i) {
   return false;
 }
 
+layouts::reduce_strategy_t layouts::reduce_strategy(ir::reduce_inst *i) {
+  unsigned axis = i->get_axis();
+  if(auto *scanline = get(i->get_operand(0))->to_scanline()){
+    // each thread holds all the elements it reduces
+    if(scanline->mts(axis) == 1)
+      return REDUCE_WARP;
+    if(tgt_->as_nvidia())
+      return scanline->warps_along(axis) == 1 ? REDUCE_WARP : REDUCE_WARP_SMEM;
+  }
+  if(is_a100_mma(i))
+    return REDUCE_MMA;
+  return REDUCE_TREE;
+}
+
+bool layouts::can_fuse(ir::reduce_inst *x, ir::reduce_inst *y) {
+  ir::value *x_arg = x->get_operand(0);
+  ir::value *y_arg = y->get_operand(0);
+  if(reduce_strategy(x) != REDUCE_WARP_SMEM || reduce_strategy(y) != REDUCE_WARP_SMEM)
+    return false;
+  if(get(x_arg) != get(y_arg) || x_arg->get_type() != y_arg->get_type())
+    return false;
+  if(x->get_axis() != y->get_axis() || x->with_index() != y->with_index())
+    return false;
+  // partial results share a buffer, so indices must be packed with values
+  return !x->with_index() ||
+         x_arg->get_type()->get_scalar_ty()->get_primitive_size_in_bits() <= 32;
+}
+
 void layouts::create_tmp_layout(size_t id, data_layout *arg,
                                 const std::vector<int> &axes,
                                 const std::vector<unsigned> &shape,
-                                ir::instruction *i, bool is_index) {
-  ir::type *ty = is_index ? ir::type::get_int32_ty(i->get_type()->get_context())
-                          : i->get_type()->get_scalar_ty();
+                                ir::instruction *i, bool is_index,
+                                ir::type *ty) {
+  if(!ty)
+    ty = is_index ? ir::type::get_int32_ty(i->get_type()->get_context())
+                  : i->get_type()->get_scalar_ty();
   layouts_[id] = new shared_layout(arg, axes, shape, {i}, ty, align_, tgt_, true);
   if (is_index) {
     tmp_index_[i] = id;
@@ -651,6 +693,8 @@ void layouts::run(ir::module &mod) {
   graph_.clear();
   layouts_.clear();
   groups_.clear();
+  tmp_.clear();
+  tmp_index_.clear();
 
   ir::for_each_instruction(mod, [this](ir::instruction* i) {
     make_graph(i);
@@ -664,6 +708,25 @@ void layouts::run(ir::module &mod) {
   for(const auto& x: values_)
     create(x.first, x.second);
 
+  // consecutive reductions that can be fused are lowered together
+  reduce_groups_.clear();
+  for(ir::function *fn: mod.get_function_list())
+  for(ir::basic_block *block: fn->blocks()){
+    std::vector<ir::reduce_inst*> group;
+    for(ir::instruction *i: block->get_inst_list()){
+      auto *red = dynamic_cast<ir::reduce_inst*>(i);
+      if(!group.empty() && !(red && can_fuse(group.front(), red))){
+        for(ir::reduce_inst *x: group)
+          reduce_groups_[x] = group;
+        group.clear();
+      }
+      if(red)
+        group.push_back(red);
+    }
+    for(ir::reduce_inst *x: group)
+      reduce_groups_[x] = group;
+  }
+
   // create temporaries
   size_t id = values_.size();
   ir::for_each_instruction(mod, [this, &id](ir::instruction* i) {
@@ -676,13 +739,31 @@ void layouts::run(ir::module &mod) {
       // shape
       auto shapes = arg->get_type()->get_block_shapes();
       unsigned axis = red->get_axis();
-      shapes[axis] =
-          layout->shape_per_cta(axis) / layout->contig_per_thread(axis);
+      reduce_strategy_t strategy = reduce_strategy(red);
+      // the first reduction of a group holds the buffer of all of them
+      const std::vector<ir::reduce_inst*>& group = reduce_group(red);
+      if(strategy == REDUCE_WARP || group.front() != red)
+        return;
+      ir::type *ty = nullptr;
+      bool has_index = red->with_index();
+      if(strategy == REDUCE_WARP_SMEM){
+        // one partial result per warp and per reduction of the group.
+        // Indices are packed with values of 32 bits or less
+        shapes[axis] = layout->to_scanline()->warps_along(axis) * group.size();
+        ir::type *arg_ty = arg->get_type()->get_scalar_ty();
+        if(has_index && arg_ty->get_primitive_size_in_bits() <= 32){
+          ty = ir::type::get_int64_ty(arg_ty->get_context());
+          has_index = false;
+        }
+      }
+      else
+        shapes[axis] =
+            layout->shape_per_cta(axis) / layout->contig_per_thread(axis);
       // create layout
       id++;
-      create_tmp_layout(id, layout, axes_->get(arg), shapes, red);
+      create_tmp_layout(id, layout, axes_->get(arg), shapes, red, false, ty);
 
-      if (red->with_index()) {
+      if (has_index) {
         id++;
         create_tmp_layout(id, layout, axes_->get(arg), shapes, red, true);
       }
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <iostream>
+#include "triton/codegen/analysis/layout.h"
+#include "triton/codegen/analysis/registers.h"
+#include "triton/ir/function.h"
+#include "triton/ir/module.h"
+#include "triton/ir/basic_block.h"
+#include "triton/ir/instructions.h"
+#include "triton/ir/utils.h"
+#include "triton/tools/sys/getenv.hpp"
+
+namespace triton{
+namespace codegen{
+namespace analysis{
+
+// values that only rename the registers of their operand
+ir::value* registers::root(ir::value* v) {
+  if(dynamic_cast<ir::splat_inst*>(v) ||
+     dynamic_cast<ir::broadcast_inst*>(v) ||
+     dynamic_cast<ir::reshape_inst*>(v))
+    return root(((ir::instruction*)v)->get_operand(0));
+  return v;
+}
+
+unsigned registers::get(ir::value* v) {
+  ir::type* ty = v->get_type();
+  ir::type* scalar_ty = ty->get_scalar_ty();
+  if(ty->is_void_ty())
+    return 0;
+  unsigned bits = scalar_ty->is_pointer_ty() ? 64 : scalar_ty->get_primitive_size_in_bits();
+  if(!ty->is_block_ty())
+    return std::max<unsigned>(1, (bits + 31) / 32);
+  distributed_layout* layout = dynamic_cast<distributed_layout*>(layouts_->get(v));
+  // shared memory tiles don't use registers
+  if(!layout)
+    return 0;
+  // predicates don't use general purpose registers
+  if(scalar_ty->is_bool_ty())
+    return 0;
+  size_t elements = 1;
+  size_t threads = 32 * num_warps_;
+  for(size_t k = 0; k < layout->get_rank(); k++){
+    unsigned shape = layout->get_shape()[k];
+    unsigned shape_per_cta = layout->shape_per_cta(k);
+    elements *= std::max<unsigned>(1, shape / shape_per_cta) * shape_per_cta;
+  }
+  elements = std::max<size_t>(1, elements / threads);
+  // the generator only materializes one address per contiguous vector
+  if(scalar_ty->is_pointer_ty())
+    elements = std::max<size_t>(1, elements / layout->contig_per_thread(layout->get_order(0)));
+  return (elements * bits + 31) / 32;
+}
+
+// fragments of the operands of a tensor-core dot, loaded from shared
+// memory for one step of the inner loop (and prefetched for the next one)
+unsigned registers::temporaries(ir::instruction* i) {
+  ir::dot_inst* dot = dynamic_cast<ir::dot_inst*>(i);
+  if(!dot || !dot->get_type()->is_block_ty())
+    return 0;
+  mma_layout* layout = layouts_->get(dot)->to_mma();
+  if(!layout)
+    return 0;
+  int k_step = layout->get_mma_instr_shape()[2];
+  unsigned ret = 0;
+  for(int k = 0; k < 2; k++){
+    ir::value* op = dot->get_operand(k);
+    unsigned bits = op->get_type()->get_scalar_ty()->get_primitive_size_in_bits();
+    unsigned per_warp = layout->get_shape()[k] / layout->wpt(k);
+    ret += 2 * ((per_warp * k_step / 32 * bits + 31) / 32);
+  }
+  return ret;
+}
+
+unsigned registers::run(ir::function* fn) {
+  typedef std::set<ir::value*> live_t;
+  auto size = [&](const live_t& live){
+    unsigned ret = 0;
+    for(ir::value* v: live)
+      ret += get(v);
+    return ret;
+  };
+  auto is_tracked = [&](ir::value* v){
+    return dynamic_cast<ir::instruction*>(v) || dynamic_cast<ir::argument*>(v);
+  };
+  std::vector<ir::basic_block*> rpo = ir::cfg::reverse_post_order(fn);
+  std::map<ir::basic_block*, live_t> live_in;
+  unsigned max_live = 0;
+  bool changed = true;
+  while(changed){
+    changed = false;
+    max_live = 0;
+    for(auto it = rpo.rbegin(); it != rpo.rend(); ++it){
+      ir::basic_block* block = *it;
+      // live-out: live-ins of successors, where phi-nodes are
+      // replaced by their incoming value from this block
+      live_t live;
+      for(ir::basic_block* succ: block->get_successors()){
+        live.insert(live_in[succ].begin(), live_in[succ].end());
+        for(ir::instruction* i: succ->get_inst_list())
+        if(auto phi = dynamic_cast<ir::phi_node*>(i)){
+          ir::value* v = root(phi->get_value_for_block(block));
+          if(is_tracked(v))
+            live.insert(v);
+        }
+      }
+      // walk the block backward
+      ir::basic_block::inst_list_t insts = block->get_inst_list();
+      for(auto iit = insts.rbegin(); iit != insts.rend(); ++iit){
+        ir::instruction* i = *iit;
+        if(root(i) != i)
+          continue;
+        live.insert(i);
+        unsigned after = size(live) + temporaries(i);
+        live.erase(i);
+        if(!dynamic_cast<ir::phi_node*>(i))
+        for(ir::value* op: i->ops()){
+          ir::value* v = root(op);
+          if(is_tracked(v))
+            live.insert(v);
+        }
+        max_live = std::max({max_live, after, size(live)});
+      }
+      if(live != live_in[block]){
+        live_in[block] = live;
+        changed = true;
+      }
+    }
+  }
+  return max_live;
+}
+
+void registers::run(ir::module &mod) {
+  max_live_ = 0;
+  for(ir::function* fn: mod.get_function_list()){
+    unsigned live = run(fn);
+    max_live_ = std::max(max_live_, live);
+    if(!tools::getenv("TRITON_CODEGEN_STATS").empty())
+      std::cerr << "registers: " << fn->get_name() << ": "
+                << live << " register(s) per thread (estimated)" << std::endl;
+  }
+}
+
+}
+}
+}
@@ -1,20 +1,68 @@
 #include "triton/codegen/extern_lib.h"
 
+#include <iostream>
+#include <map>
+#include <mutex>
+
+#include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Type.h"
 #include "llvm/Linker/Linker.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "triton/codegen/pass.h"
+#include "triton/tools/sys/getenv.hpp"
 
 namespace triton {
 
 namespace codegen {
 
+// Content of the library files, read once per process. Modules are bound to
+// an LLVMContext and consumed by the linker, so every compilation re-creates
+// one from the cached bytes. Buffers are shared: a lazily loaded module reads
+// from its buffer until it is linked, even if the file was reloaded meanwhile.
+static std::shared_ptr<llvm::MemoryBuffer> read_cached(const std::string& path) {
+  static std::mutex mutex;
+  static std::map<std::string, std::pair<llvm::sys::TimePoint<>, std::shared_ptr<llvm::MemoryBuffer>>> cache;
+  llvm::sys::fs::file_status status;
+  if (llvm::sys::fs::status(path, status))
+    return nullptr;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& entry = cache[path];
+  bool hit = entry.second && entry.first == status.getLastModificationTime() &&
+             entry.second->getBufferSize() == status.getSize();
+  if (!hit) {
+    auto buffer = llvm::MemoryBuffer::getFile(path);
+    if (!buffer)
+      return nullptr;
+    entry = {status.getLastModificationTime(), std::move(*buffer)};
+  }
+  if (!tools::getenv("TRITON_CODEGEN_STATS").empty())
+    std::cerr << "extern_lib: " << path << ": " << (hit ? "cached" : "read") << std::endl;
+  return entry.second;
+}
+
 std::unique_ptr<llvm::Module> ExternLib::load(llvm::LLVMContext& ctx) {
-  llvm::SMDiagnostic err;
-  auto mod = llvm::parseIRFile(this->path_, err, ctx);
+  std::unique_ptr<llvm::Module> mod;
+  buffer_ = read_cached(this->path_);
+  if (buffer_) {
+    llvm::MemoryBufferRef ref = buffer_->getMemBufferRef();
+    if (llvm::isBitcode(reinterpret_cast<const unsigned char*>(ref.getBufferStart()),
+                        reinterpret_cast<const unsigned char*>(ref.getBufferEnd()))) {
+      // function bodies are only read if the linker needs them
+      auto lazy = llvm::getLazyBitcodeModule(ref, ctx);
+      if (lazy)
+        mod = std::move(*lazy);
+      else
+        llvm::consumeError(lazy.takeError());
+    } else {
+      llvm::SMDiagnostic err;
+      mod = llvm::parseIR(ref, err, ctx);
+    }
+  }
   if (!mod) {
     throw std::runtime_error("Failed to load extern lib " + this->name_ +
                              " at " + this->path_);
@@ -27,7 +75,9 @@ void ExternLib::link(std::unique_ptr<llvm::Module>& llvm,
   // Set triple and data layout to match the target module
   mod->setTargetTriple(llvm->getTargetTriple());
   mod->setDataLayout(llvm->getDataLayout());
-  if (llvm::Linker::linkModules(*llvm, std::move(mod))) {
+  // Only bring the functions (transitively) called by the kernel
+  if (llvm::Linker::linkModules(*llvm, std::move(mod),
+                                llvm::Linker::Flags::LinkOnlyNeeded)) {
     throw std::runtime_error("Failed to link extern lib " + this->name_ +
                              " at " + this->path_);
   }
@@ -1,6 +1,7 @@
 #include "triton/codegen/pass.h"
 
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
@@ -13,6 +14,7 @@
 #include "triton/codegen/analysis/allocation.h"
 #include "triton/codegen/analysis/axes.h"
 #include "triton/codegen/analysis/liveness.h"
+#include "triton/codegen/analysis/registers.h"
 #include "triton/codegen/analysis/swizzle.h"
 #include "triton/codegen/selection/generator.h"
 #include "triton/codegen/transform/coalesce.h"
@@ -24,17 +26,64 @@
 #include "triton/codegen/transform/peephole.h"
 #include "triton/codegen/transform/pipeline.h"
 #include "triton/codegen/transform/prefetch.h"
+#include "triton/codegen/transform/reorder.h"
 #include "triton/ir/function.h"
 #include "triton/ir/module.h"
 #include "triton/ir/print.h"
 
+#include <chrono>
+
 namespace triton {
 namespace codegen {
 
+// Runs `f` and adds its duration to the entry `name` of `timings`, if any
+template<class F>
+static void timed(pass_timings* timings, const std::string& name, F&& f) {
+  if (!timings) {
+    f();
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+  for (auto& entry : *timings)
+    if (entry.first == name) {
+      entry.second += ms.count();
+      return;
+    }
+  timings->emplace_back(name, ms.count());
+}
+
+// Extern device functions that are large and called from many places are
+// kept out-of-line as real calls: inlining every call site (e.g., one per
+// element of a block) mostly costs compile time and instruction cache.
+// Functions marked cold are never worth inlining.
+static const size_t min_outlined_size = 128;
+static const size_t max_inlining_growth = 1024;
+
+static void outline_large_functions(llvm::Module& llvm,
+                                    const std::set<llvm::StringRef>& kernels) {
+  for (llvm::Function& fn : llvm) {
+    if (fn.isDeclaration() || kernels.count(fn.getName()) != 0)
+      continue;
+    size_t size = fn.getInstructionCount();
+    size_t num_calls = 0;
+    for (llvm::User* user : fn.users())
+      if (llvm::isa<llvm::CallBase>(user))
+        num_calls++;
+    bool is_large = size >= min_outlined_size && num_calls > 1 &&
+                    size * (num_calls - 1) > max_inlining_growth;
+    if (is_large || fn.hasFnAttribute(llvm::Attribute::Cold)) {
+      fn.removeFnAttr(llvm::Attribute::AlwaysInline);
+      fn.addFnAttr(llvm::Attribute::NoInline);
+    }
+  }
+}
+
 static void link_extern_libs(const ExternLibMap& user_extern_lib_map,
                              const ExternLibMap& target_extern_lib_map,
                              ir::module& ir, llvm::LLVMContext& ctx,
-                             std::unique_ptr<llvm::Module>& llvm) {
+                             std::unique_ptr<llvm::Module>& llvm, int opt_level) {
   for (const auto& iter : target_extern_lib_map) {
     auto &lib_name = iter.first;
     if (user_extern_lib_map.count(lib_name) != 0 &&
@@ -51,6 +100,8 @@ static void link_extern_libs(const ExternLibMap& user_extern_lib_map,
   for (auto& func : ir.get_function_list()) {
     function_names.insert(func->get_name());
   }
+  outline_large_functions(*llvm, function_names);
+
   llvm::legacy::PassManager pass;
   pass.add(llvm::createInternalizePass([&](const llvm::GlobalValue& v) -> bool {
     if (function_names.count(v.getName()) != 0) {
@@ -65,10 +116,14 @@ static void link_extern_libs(const ExternLibMap& user_extern_lib_map,
   pm.add(llvm::createVerifierPass());
   pm.run(*llvm);
 
-  llvm::PassManagerBuilder builder;
-  builder.OptLevel = 3;
-  builder.SizeLevel = 0;
-  builder.populateModulePassManager(pass);
+  // at -O0, unused library functions are still removed by internalization
+  // but the linked module is not optimized
+  if (opt_level > 0) {
+    llvm::PassManagerBuilder builder;
+    builder.OptLevel = opt_level;
+    builder.SizeLevel = 0;
+    builder.populateModulePassManager(pass);
+  }
 
   pass.run(*llvm);
 }
@@ -77,8 +132,9 @@ static void link_extern_libs(const ExternLibMap& user_extern_lib_map,
 // There should be a proper pass manager there!
 std::unique_ptr<llvm::Module> add_passes_to_emit_bin(
     ir::module& ir, llvm::LLVMContext& ctx, codegen::target* target,
-    int num_warps, int num_stages, int& shared_static,
-    const ExternLibMap& extern_lib_map) {
+    int num_warps, int num_stages, int& shared_static, int& n_regs_estimate,
+    const ExternLibMap& extern_lib_map, int opt_level, pass_timings* timings,
+    int max_regs) {
   // generate llvm code
   std::string name = ir.get_function_list()[0]->get_name();
   std::unique_ptr<llvm::Module> llvm(new llvm::Module(name, ctx));
@@ -88,72 +144,87 @@ std::unique_ptr<llvm::Module> add_passes_to_emit_bin(
   codegen::analysis::align align;
   codegen::transform::inliner inliner;
   codegen::analysis::axes axes;
-  codegen::transform::pipeline pipeline(has_sm80, num_stages);
+  codegen::transform::pipeline pipeline(has_sm80, num_stages, num_warps);
   codegen::transform::disassociate disassociate;
   codegen::analysis::layouts layouts(&axes, &align, num_warps, target);
   codegen::transform::cts cts(&layouts, has_sm80);
   codegen::analysis::liveness liveness(&layouts);
   codegen::analysis::swizzle swizzle(&layouts, target);
   codegen::analysis::allocation allocation(&liveness);
+  codegen::analysis::registers registers(&layouts, num_warps);
   codegen::transform::dce dce;
   codegen::transform::peephole peephole(target, &layouts);
   codegen::transform::coalesce coalesce(&align, &layouts, has_sm80);
   codegen::transform::prefetch prefetch_s(target);
+  codegen::transform::reorder reorder(&layouts);
   codegen::transform::membar barriers(&liveness, &layouts, &allocation,
                                       &prefetch_s, target);
   codegen::generator isel(&axes, &layouts, &align, &allocation, &swizzle,
                           target, num_warps);
   // run passes
-  inliner.run(ir);
-  dce.run(ir);
+  auto run = [&](const char* name, auto& pass) {
+    timed(timings, name, [&]() { pass.run(ir); });
+  };
+  run("inliner", inliner);
+  run("dce", dce);
   // ir.print(std::cout);
-  peephole.run(ir);
-  dce.run(ir);
-  pipeline.run(ir);
-  dce.run(ir);
-  disassociate.run(ir);
-  dce.run(ir);
-  align.run(ir);
-  axes.run(ir);
-  layouts.run(ir);
-  peephole.run(ir);
-  dce.run(ir);
-  if (target->is_gpu()) cts.run(ir);
-  align.run(ir);
-  axes.run(ir);
-  layouts.run(ir);
-  coalesce.run(ir);
-  dce.run(ir);
-  align.run(ir);
-  dce.run(ir);
-  if (target->is_gpu()) cts.run(ir);
-  dce.run(ir);
-  align.run(ir);
-  axes.run(ir);
-  layouts.run(ir);
-  peephole.run(ir);
-  dce.run(ir);
-  align.run(ir);
-  axes.run(ir);
-  layouts.run(ir);
-  swizzle.run(ir);
+  run("peephole", peephole);
+  run("dce", dce);
+  run("pipeline", pipeline);
+  run("dce", dce);
+  run("disassociate", disassociate);
+  run("dce", dce);
+  run("align", align);
+  run("axes", axes);
+  run("layouts", layouts);
+  run("peephole", peephole);
+  run("dce", dce);
+  if (target->is_gpu()) run("cts", cts);
+  run("align", align);
+  run("axes", axes);
+  run("layouts", layouts);
+  run("coalesce", coalesce);
+  run("dce", dce);
+  run("align", align);
+  run("dce", dce);
+  if (target->is_gpu()) run("cts", cts);
+  run("dce", dce);
+  run("align", align);
+  run("axes", axes);
+  run("layouts", layouts);
+  run("peephole", peephole);
+  run("dce", dce);
+  run("align", align);
+  run("axes", axes);
+  run("layouts", layouts);
+  run("reorder", reorder);
+  run("layouts", layouts);
+  run("swizzle", swizzle);
   // std::cout << "---" << std::endl;
   // ir.print(std::cout);
   // std::cout << "---" << std::endl;
   // ir.print(std::cout);
-  liveness.run(ir);
-  allocation.run(ir);
-  prefetch_s.run(ir);
-  barriers.run(ir);
+  run("liveness", liveness);
+  run("allocation", allocation);
+  run("prefetch", prefetch_s);
+  run("membar", barriers);
+  run("registers", registers);
+  shared_static = allocation.allocated_size();
+  n_regs_estimate = registers.max_live();
+  // bound to spill: don't pay for isel and extern lib linking
+  if (max_regs > 0 && n_regs_estimate > max_regs)
+    return nullptr;
   // exit(1);
   // ir.print(std::cout);
-  isel.visit(ir, *llvm);
-  shared_static = allocation.allocated_size();
+  timed(timings, "isel", [&]() { isel.visit(ir, *llvm); });
 
   if (isel.get_extern_lib_map().size() > 0) {
     // If there's any extern lib calls,
     // we need to link them in.
-    link_extern_libs(extern_lib_map, isel.get_extern_lib_map(), ir, ctx, llvm);
+    timed(timings, "link_extern_libs", [&]() {
+      link_extern_libs(extern_lib_map, isel.get_extern_lib_map(), ir, ctx, llvm,
+                       opt_level);
+    });
   }
 
   return llvm;
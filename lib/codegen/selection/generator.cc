@@ -1,4 +1,6 @@
 ﻿#include <numeric>
+#include <chrono>
+#include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <stdexcept>
@@ -14,6 +16,7 @@
 #include "triton/ir/function.h"
 #include "triton/ir/type.h"
 #include "triton/ir/utils.h"
+#include "triton/tools/sys/getenv.hpp"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/IntrinsicsNVPTX.h"
@@ -100,6 +103,7 @@ Value* geper::operator()(Value *ptr, Value* off, const std::string& name){
 #define ptr_ty(...)          PointerType::get(__VA_ARGS__)
 // constants
 #define i32(...)             builder_->getInt32(__VA_ARGS__)
+#define i64(...)             builder_->getInt64(__VA_ARGS__)
 // ops
 #define and_(...)            builder_->CreateAnd(__VA_ARGS__)
 #define atomic_cmp_xchg(...) builder_->CreateAtomicCmpXchg(__VA_ARGS__)
@@ -115,6 +119,7 @@ Value* geper::operator()(Value *ptr, Value* off, const std::string& name){
 #define extract_val(...)     builder_->CreateExtractValue(__VA_ARGS__)
 #define fadd(...)            builder_->CreateFAdd(__VA_ARGS__)
 #define fcmp(...)            builder_->CreateFCmp(__VA_ARGS__)
+#define fcmp_oeq(...)        builder_->CreateFCmpOEQ(__VA_ARGS__)
 #define fcmp_oge(...)        builder_->CreateFCmpOGE(__VA_ARGS__)
 #define fcmp_ole(...)        builder_->CreateFCmpOLE(__VA_ARGS__)
 #define fmul(...)            builder_->CreateFMul(__VA_ARGS__)
@@ -134,16 +139,19 @@ Value* geper::operator()(Value *ptr, Value* off, const std::string& name){
 #define max_num(...)         builder_->CreateMaxNum(__VA_ARGS__)
 #define min_num(...)         builder_->CreateMinNum(__VA_ARGS__)
 #define neg(...)             builder_->CreateNeg(__VA_ARGS__)
+#define or_(...)             builder_->CreateOr(__VA_ARGS__)
 #define phi(...)             builder_->CreatePHI(__VA_ARGS__)
 #define ret(...)             builder_->CreateRet(__VA_ARGS__)
 #define select(...)          builder_->CreateSelect(__VA_ARGS__)
 #define store(...)           builder_->CreateStore(__VA_ARGS__)
 #define sub(...)             builder_->CreateSub(__VA_ARGS__)
 #define shl(...)             builder_->CreateShl(__VA_ARGS__)
+#define trunc(...)           builder_->CreateTrunc(__VA_ARGS__)
 #define udiv(...)            builder_->CreateUDiv(__VA_ARGS__)
 #define urem(...)            builder_->CreateURem(__VA_ARGS__)
 #define splat(...)           builder_->CreateVectorSplat(__VA_ARGS__)
 #define xor_(...)            builder_->CreateXor(__VA_ARGS__)
+#define zext(...)            builder_->CreateZExt(__VA_ARGS__)
 
 /**
  * \brief Convert Triton-IR Type to LLVM-IR Type
@@ -207,6 +215,58 @@ llvm::Attribute generator::cvt(ir::attribute attr) {
   }
 }
 
+size_t indices_hash::operator()(const indices_t& idx) const {
+  size_t ret = idx.size();
+  for(Value* x: idx)
+    ret ^= std::hash<Value*>()(x) + 0x9e3779b9 + (ret << 6) + (ret >> 2);
+  return ret;
+}
+
+void block_values::bind(const std::vector<indices_t>* idxs) {
+  idxs_ = idxs;
+  vals_.assign(idxs->size(), nullptr);
+  pos_.clear();
+  // elements set before the indices were known
+  std::map<indices_t, Value*> others;
+  std::swap(others, others_);
+  for(auto& x: others)
+    (*this)[x.first] = x.second;
+}
+
+Value*& block_values::operator[](const indices_t& idx) {
+  if(idxs_){
+    // values of scalars have a single element
+    if(vals_.size() == 1 && (*idxs_)[0] == idx)
+      return vals_[0];
+    if(pos_.empty())
+      for(size_t i = 0; i < idxs_->size(); i++)
+        pos_.emplace((*idxs_)[i], i);
+    auto it = pos_.find(idx);
+    if(it != pos_.end())
+      return vals_[it->second];
+  }
+  return others_[idx];
+}
+
+block_values& value_map::operator[](ir::value* v) {
+  static const std::vector<indices_t> scalar_idxs = {{}};
+  block_values& ret = vals_[v];
+  if(!ret.bound()){
+    auto it = idxs_.find(v);
+    if(it != idxs_.end() && !it->second.empty())
+      ret.bind(&it->second);
+    else if(!v->get_type()->is_block_ty())
+      ret.bind(&scalar_idxs);
+  }
+  return ret;
+}
+
+block_values& value_map::at(ir::value* v) {
+  if(vals_.find(v) == vals_.end())
+    throw std::out_of_range("no value for ir::value");
+  return (*this)[v];
+}
+
 /**
  * \brief Constructor of LLVM code generator
  */
@@ -218,7 +278,7 @@ generator::generator(analysis::axes *a_axes,
                     target *tgt,
                     unsigned num_warps)
   : a_axes_(a_axes), layouts_(layouts), alignment_(alignment), alloc_(alloc), swizzle_(swizzle),
-    tgt_(tgt), num_warps_(num_warps), add(&builder_), mul(&builder_), gep(&builder_) {
+    tgt_(tgt), num_warps_(num_warps), vals_(idxs_), add(&builder_), mul(&builder_), gep(&builder_) {
 
 }
 
@@ -297,8 +357,9 @@ void generator::visit_value(ir::value* v) {
  */
 void generator::visit_phi_node(ir::phi_node* x) {
   Type *ty = cvt(x->get_type()->get_scalar_ty());
-  for(indices_t idx: idxs_.at(x))
-    vals_[x][idx] = phi(ty, x->get_num_operands());
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++)
+    ret.at(i) = phi(ty, x->get_num_operands());
 }
 
 /**
@@ -406,9 +467,12 @@ void generator::visit_binary_operator(ir::binary_operator*x) {
     }
   };
 //  x->print(std::cout);
-  for(indices_t idx: idxs_.at(x)){
-    Value *lhs = vals_[x->get_operand(0)][idx];
-    Value *rhs = vals_[x->get_operand(1)][idx];
+  block_values& lhs_vals = vals_[x->get_operand(0)];
+  block_values& rhs_vals = vals_[x->get_operand(1)];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++){
+    Value *lhs = lhs_vals.at(i);
+    Value *rhs = rhs_vals.at(i);
     // manually select bf16 bin op
     if (x->get_operand(0)->get_type()->get_scalar_ty()->is_bf16_ty()) {
       assert(x->get_operand(1)->get_type()->get_scalar_ty()->is_bf16_ty());
@@ -419,7 +483,7 @@ void generator::visit_binary_operator(ir::binary_operator*x) {
                            "   mov.b16 c, 0x3f80U; \n\t" // 1.0
                            "   fma.rn.bf16 $0, $1, c, $2; } \n\t",
                            "=h,h,h", false);
-        vals_[x][idx] = builder_->CreateCall(bf16_add_asm, {lhs, rhs});
+        ret.at(i) = builder_->CreateCall(bf16_add_asm, {lhs, rhs});
       } else if (x->get_op() == tt::FSub) {  // a - b = b * (-1.0) + a
         InlineAsm *bf16_sub_asm =
             InlineAsm::get(FunctionType::get(bf16_ty, {bf16_ty, bf16_ty}, false),
@@ -427,7 +491,7 @@ void generator::visit_binary_operator(ir::binary_operator*x) {
                            "    mov.b16 c, 0xbf80U; \n\t" // -1.0
                            "    fma.rn.bf16 $0, $2, c, $1;} \n\t",
                            "=h,h,h", false);
-        vals_[x][idx] = builder_->CreateCall(bf16_sub_asm, {lhs, rhs});
+        ret.at(i) = builder_->CreateCall(bf16_sub_asm, {lhs, rhs});
       } else if (x->get_op() == tt::FMul) {  // a * b = a*b + 0
         InlineAsm *bf16_mul_asm =
           InlineAsm::get(FunctionType::get(bf16_ty, {bf16_ty, bf16_ty}, false),
@@ -435,24 +499,24 @@ void generator::visit_binary_operator(ir::binary_operator*x) {
                            "    mov.b16 c, 0x8000U; \n\t" // 0.0
                            "    fma.rn.bf16 $0, $1, $2, c;} \n\t",
                            "=h,h,h", false);
-        vals_[x][idx] = builder_->CreateCall(bf16_mul_asm, {lhs, rhs});
+        ret.at(i) = builder_->CreateCall(bf16_mul_asm, {lhs, rhs});
       } else
         throw std::runtime_error("invalid bin op for bf16");
     } else {  // not bf16
       auto op = cvt(x->get_op());
       if(op == ll::Add)
-        vals_[x][idx] = add(lhs, rhs);
+        ret.at(i) = add(lhs, rhs);
       else if(op == ll::Mul)
-        vals_[x][idx] = mul(lhs, rhs);
+        ret.at(i) = mul(lhs, rhs);
       else if(op == ll::FDiv && !x->get_fdiv_ieee_rounding() &&
               x->get_type()->get_scalar_ty()->is_fp32_ty()){
         InlineAsm *ptx = InlineAsm::get(FunctionType::get(f32_ty, {f32_ty, f32_ty}, false),
                                         " div.full.f32 $0, $1, $2;", "=r,r,r", false);
-        vals_[x][idx] = builder_->CreateCall(ptx, {lhs, rhs});
+        ret.at(i) = builder_->CreateCall(ptx, {lhs, rhs});
 
       }
       else
-        vals_[x][idx] = bin_op(op, lhs, rhs);
+        ret.at(i) = bin_op(op, lhs, rhs);
     }
   }
 }
@@ -461,14 +525,12 @@ void generator::visit_binary_operator(ir::binary_operator*x) {
  * \brief Code Generation for `getelementptr`
  */
 void generator::visit_getelementptr_inst(ir::getelementptr_inst* x) {
-  for(indices_t idx: idxs_.at(x)){
-    Value *ptr = vals_[x->get_pointer_operand()][idx];
-    std::vector<Value*> vals;
-    for(auto it= x->idx_begin(); it != x->idx_end(); it++)
-      vals.push_back(vals_[*it][idx]);
-    assert(vals.size() == 1);
-    vals_[x][idx] = gep(ptr, vals[0]);
-  }
+  assert(x->idx_end() - x->idx_begin() == 1);
+  block_values& ptrs = vals_[x->get_pointer_operand()];
+  block_values& offs = vals_[*x->idx_begin()];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++)
+    ret.at(i) = gep(ptrs.at(i), offs.at(i));
 }
 
 /**
@@ -495,11 +557,11 @@ void generator::visit_icmp_inst(ir::icmp_inst* x) {
     }
   };
 
-  for(indices_t idx: idxs_.at(x)){
-    Value *lhs = vals_[x->get_operand(0)][idx];
-    Value *rhs = vals_[x->get_operand(1)][idx];
-    vals_[x][idx] = icmp(cvt(x->get_pred()), lhs, rhs);
-  }
+  block_values& lhs = vals_[x->get_operand(0)];
+  block_values& rhs = vals_[x->get_operand(1)];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++)
+    ret.at(i) = icmp(cvt(x->get_pred()), lhs.at(i), rhs.at(i));
 }
 
 /**
@@ -531,11 +593,11 @@ void generator::visit_fcmp_inst(ir::fcmp_inst* x) {
       default: throw std::runtime_error("unreachable switch");
     }
   };
-  for(indices_t idx: idxs_.at(x)){
-    Value *lhs = vals_[x->get_operand(0)][idx];
-    Value *rhs = vals_[x->get_operand(1)][idx];
-    vals_[x][idx] = fcmp(cvt(x->get_pred()), lhs, rhs);
-  }
+  block_values& lhs = vals_[x->get_operand(0)];
+  block_values& rhs = vals_[x->get_operand(1)];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++)
+    ret.at(i) = fcmp(cvt(x->get_pred()), lhs.at(i), rhs.at(i));
 }
 
 
@@ -768,8 +830,8 @@ void generator::visit_cast_inst(ir::cast_inst* x) {
   ir::value *op = x->get_operand(0);
   ir::type* ret_sca_ty = x->get_type()->get_scalar_ty();
   ir::type* op_sca_ty = op->get_type()->get_scalar_ty();
-  auto x_idxs = idxs_.at(x);
-  auto op_idxs = idxs_.at(op);
+  const auto& x_idxs = idxs_.at(x);
+  const auto& op_idxs = idxs_.at(op);
 
   // <> FP8
   if(ret_sca_ty->is_fp8_ty() || op_sca_ty->is_fp8_ty()){
@@ -848,10 +910,10 @@ void generator::visit_cast_inst(ir::cast_inst* x) {
       default: throw std::runtime_error("unreachable switch");
     }
   };
-  for(indices_t idx: idxs_.at(x)){
-    Value *arg = vals_[x->get_operand(0)][idx];
-    vals_[x][idx] = cast(cvt(x->get_op()), arg, ty);
-  }
+  block_values& args = vals_[x->get_operand(0)];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++)
+    ret.at(i) = cast(cvt(x->get_op()), args.at(i), ty);
 }
 
 /**
@@ -880,6 +942,79 @@ void generator::visit_uncond_branch_inst(ir::uncond_branch_inst* br) {
   br(dest);
 }
 
+/**
+ * \brief Vectorization of a global memory access
+ *
+ * Groups the elements of `val` held by each thread into accesses of at most
+ * 128 bits, and returns their positions in `idxs_`. Elements of an access
+ * are contiguous along the leading dimension of the layout or, when it
+ * cannot be vectorized, along the next dimension in order that can.
+ */
+std::vector<std::vector<size_t>> generator::io_vectors(ir::io_inst* x, ir::value* val, size_t nbits) {
+  ir::value *ptr = x->get_pointer_operand();
+  ir::value *msk = nullptr;
+  if(auto *mx = dynamic_cast<ir::masked_load_inst*>(x))
+    msk = mx->get_mask_operand();
+  if(auto *mx = dynamic_cast<ir::masked_store_inst*>(x))
+    msk = mx->get_mask_operand();
+  size_t n = idxs_.at(val).size();
+  size_t vec = 1;
+  size_t stride = 1;
+  if(val->get_type()->is_block_ty()){
+    auto ord = ords_.at(ptr);
+    auto shapes = val->get_type()->get_block_shapes();
+    analysis::distributed_layout* layout = dynamic_cast<analysis::distributed_layout*>(layouts_->get(ptr));
+    assert(layout);
+    // alignment along each dimension
+    auto aln_along = [&](int d) -> size_t {
+      size_t aln = alignment_->get(ptr, d);
+      if(msk){
+        // elements of an access share a predicate
+        size_t max_eq = alignment_->get_cst_info(msk)[d].num_cst;
+        aln = std::min<size_t>(aln, std::max<size_t>(max_eq, 1));
+      }
+      return aln;
+    };
+    // widest access along each dimension
+    auto vec_along = [&](int d) -> size_t {
+      size_t ret = std::min<size_t>(layout->contig_per_thread(d), aln_along(d));
+      return std::max<size_t>(1, std::min<size_t>(ret, 128 / std::max<size_t>(nbits, 1)));
+    };
+    vec = vec_along(ord[0]);
+    // TODO: generalize
+    bool is_mma_first_row = (ord.size() >= 1) && layout->to_mma() &&
+                       (a_axes_->get(ptr, ord[0]) == layout->get_axis(1));
+    if(is_mma_first_row)
+      vec = std::min<size_t>(2, aln_along(ord[0]));
+    // elements along the other dimensions are `stride` apart in `idxs_`
+    size_t step = 1;
+    for(size_t k = 0; k < ord.size(); k++){
+      int d = ord[k];
+      size_t per_thread = shapes[d] > 1 ? axes_.at(a_axes_->get(val, d)).values.size() : 1;
+      if(k > 0 && vec == 1 && layout->to_scanline()){
+        vec = vec_along(d);
+        stride = step;
+      }
+      step *= per_thread;
+    }
+  }
+  std::vector<std::vector<size_t>> ret;
+  for(size_t i = 0; i < n; i++){
+    if((i / stride) % vec != 0)
+      continue;
+    std::vector<size_t> pos(vec);
+    for(size_t k = 0; k < vec; k++)
+      pos[k] = i + k*stride;
+    ret.push_back(pos);
+  }
+  if(!tools::getenv("TRITON_CODEGEN_STATS").empty()){
+    std::cerr << "io: " << x->get_parent()->get_parent()->get_name() << ": "
+              << (dynamic_cast<ir::load_inst*>(x) ? "load" : "store") << ": "
+              << ret.size() << " access(es) of " << vec*nbits << " bits" << std::endl;
+  }
+  return ret;
+}
+
 /**
  * \brief Code Generation for a (synchronous) `load`
  */
@@ -891,35 +1026,14 @@ void generator::visit_load_inst(ir::load_inst* x){
   ir::value *op = x->get_pointer_operand();
   ir::masked_load_inst *mx = dynamic_cast<ir::masked_load_inst*>(x);
   Type* ty  = cvt(op->get_type()->get_scalar_ty()->get_pointer_element_ty());
-  // compute vector width
-  size_t vec = 1;
-  bool is_mma_first_row = false;
-  if(op->get_type()->is_block_ty()){
-    auto   ord = ords_.at(op);
-    size_t aln = alignment_->get(op, ord[0]);
-    if(mx){
-      size_t max_eq = alignment_->get_cst_info(mx->get_mask_operand())[ord[0]].num_cst;
-      max_eq = std::max<size_t>(max_eq, 1);
-      aln = std::min(aln, max_eq);
-    }
-    analysis::distributed_layout* layout = dynamic_cast<analysis::distributed_layout*>(layouts_->get(x));
-    assert(layout);
-
-    vec = std::min<size_t>(layout->contig_per_thread(ord[0]), aln);
-    // TODO: generalize
-    is_mma_first_row = (ord.size() >= 1) && layout->to_mma() && 
-                       (a_axes_->get(x, ord[0]) == layouts_->get(x)->get_axis(1));
-    if(is_mma_first_row)
-      vec = std::min<size_t>(2, aln);
-  }
   // code generation
-  auto idxs = idxs_.at(x);
-  for(size_t i = 0; i < idxs.size(); i += vec){
-    indices_t idx = idxs[i];
+  const auto& idxs = idxs_.at(x);
+  size_t dtsize = x->get_type()->get_scalar_ty()->get_primitive_size_in_bits() / 8;
+  for(const std::vector<size_t>& pos: io_vectors(x, x, dtsize*8)){
+    size_t vec = pos.size();
+    indices_t idx = idxs[pos[0]];
     // pointer value
     Value *ptr = vals_[op][idx];
-    // masked load
-    size_t dtsize = x->get_type()->get_scalar_ty()->get_primitive_size_in_bits() / 8;
     // input ptr info
     GetElementPtrInst *in_gep = dyn_cast<GetElementPtrInst>(ptr);
     size_t in_off;
@@ -984,7 +1098,7 @@ void generator::visit_load_inst(ir::load_inst* x){
       Value *v = UndefValue::get(vec_ty(ty, size));
       for(size_t s = 0; s < size; s++){
         ir::value *false_val = mx->get_false_value_operand();
-        v = insert_elt(v, vals_[false_val][idxs[i + ii*size + s]], s);
+        v = insert_elt(v, vals_[false_val][idxs[pos[ii*size + s]]], s);
       }
       v = bit_cast(v, IntegerType::get(*ctx_, width));
       asm_oss << "\n        ";
@@ -1065,7 +1179,7 @@ void generator::visit_load_inst(ir::load_inst* x){
     }
     int tmp = (width / (dtsize * 8));
     for(size_t ii = 0; ii < vec; ii++)
-      vals_[x][idxs[i+ii]] = extract_elt(rets[ii/tmp], ii % tmp);
+      vals_[x][idxs[pos[ii]]] = extract_elt(rets[ii/tmp], ii % tmp);
   }
 }
 
@@ -1081,45 +1195,24 @@ void generator::visit_masked_load_inst(ir::masked_load_inst* x) {
  */
 
 void generator::visit_store_inst(ir::store_inst * x){
-  ir::masked_store_inst *mx = dynamic_cast<ir::masked_store_inst*>(x);
   // operands
   ir::value *ptr_op = x->get_pointer_operand();
   ir::value *val_op = x->get_value_operand();
   ir::value *msk_op = nullptr;
   if(auto* msk_st = dynamic_cast<ir::masked_store_inst*>(x))
     msk_op = msk_st->get_mask_operand();
-  // vector size
-  size_t vec = 1;
-  if(val_op->get_type()->is_block_ty()){
-    auto ord = ords_.at(x->get_pointer_operand());
-    size_t aln = alignment_->get(ptr_op, ord[0]);
-    size_t nts = axes_.at(a_axes_->get(x->get_pointer_operand(), ord[0])).contiguous;
-    if(mx){
-      size_t max_eq = alignment_->get_cst_info(mx->get_mask_operand())[ord[0]].num_cst;
-      max_eq = std::max<size_t>(max_eq, 1);
-      aln = std::min(aln, max_eq);
-    }
-    analysis::distributed_layout* layout = dynamic_cast<analysis::distributed_layout*>(layouts_->get(ptr_op));
-    assert(layout);
-    // vec  = std::min(nts, aln);
-    vec = std::min<size_t>(layout->contig_per_thread(ord[0]), aln);
-    // TODO: generalize
-    bool is_mma_first_row = (ord.size() >= 1) && layout->to_mma() && 
-                       (a_axes_->get(ptr_op, ord[0]) == layouts_->get(ptr_op)->get_axis(1));
-    if(is_mma_first_row)
-      vec = std::min<size_t>(2, aln);
-  }
   bool has_l2_evict_policy = (x->get_eviction_policy() != ir::load_inst::NORMAL) && tgt_->as_nvidia()->sm() >= 80;
   has_l2_evict_policy = false;
-  auto idxs    = idxs_.at(val_op);
+  const auto& idxs    = idxs_.at(val_op);
   Type *ty = cvt(val_op->get_type()->get_scalar_ty());
   if(ty->isIntegerTy(1))
     ty = builder_->getInt8Ty();
-  for(size_t i = 0; i < idxs.size(); i += vec){
-    indices_t idx = idxs[i];
+  size_t dtsize = std::max<int>(1, val_op->get_type()->get_scalar_ty()->get_primitive_size_in_bits() / 8);
+  for(const std::vector<size_t>& pos: io_vectors(x, val_op, dtsize*8)){
+    size_t vec = pos.size();
+    indices_t idx = idxs[pos[0]];
     // pointers
     Value *ptr = vals_[ptr_op][idx];
-    size_t dtsize = std::max<int>(1, val_op->get_type()->get_scalar_ty()->get_primitive_size_in_bits() / 8);
     GetElementPtrInst *in_gep = dyn_cast<GetElementPtrInst>(ptr);
     size_t in_off;
     if(in_gep){
@@ -1188,7 +1281,7 @@ void generator::visit_store_inst(ir::store_inst * x){
       size_t n_subw = width / nbits;
       Value* curr = UndefValue::get(vec_ty(ty, n_subw));
       for(unsigned int jj = 0; jj < n_subw; jj++){
-        Value* new_elt = vals_[val_op][idxs[i + ii*n_subw + jj]];
+        Value* new_elt = vals_[val_op][idxs[pos[ii*n_subw + jj]]];
         if(new_elt->getType()->isIntegerTy(1))
           new_elt = builder_->CreateSExt(new_elt, builder_->getInt8Ty());
         new_elt = bit_cast(new_elt, ty);
@@ -1211,7 +1304,7 @@ void generator::visit_masked_store_inst(ir::masked_store_inst* x) {
 // --
 
 void generator::visit_extract_value_inst(ir::extract_value_inst *x) {
-  auto idxs    = idxs_.at(x);
+  const auto& idxs    = idxs_.at(x);
   ir::value* agg = x->get_operand(0);
   unsigned insert_idx = x->get_idx();
   for(size_t i = 0; i < idxs.size(); i++){
@@ -1222,7 +1315,7 @@ void generator::visit_extract_value_inst(ir::extract_value_inst *x) {
 
 
 void generator::visit_insert_value_inst(ir::insert_value_inst *x){
-  auto idxs    = idxs_.at(x);
+  const auto& idxs    = idxs_.at(x);
   ir::value* agg = x->get_operand(0);
   ir::value* val = x->get_operand(1);
   unsigned insert_idx = x->get_idx();
@@ -1237,7 +1330,6 @@ void generator::visit_insert_value_inst(ir::insert_value_inst *x){
  * \brief Code Generation for `cat`
  */
 void generator::visit_cat_inst(ir::cat_inst* x) {
-  auto idxs = idxs_.at(x);
   ir::value* lhs = x->get_operand(0);
   ir::value* rhs = x->get_operand(1);
   int i = 0;
@@ -1255,7 +1347,6 @@ void generator::visit_cat_inst(ir::cat_inst* x) {
  * \brief Code Generation for `reshape`
  */
 void generator::visit_reshape_inst(ir::reshape_inst* x) {
-  auto idxs = idxs_.at(x);
   for(size_t i = 0; i < idxs_.at(x).size(); i ++){
     ir::value* op = x->get_operand(0);
     vals_[x][idxs_[x][i]] = vals_[op][idxs_[op][i]];
@@ -1266,8 +1357,10 @@ void generator::visit_reshape_inst(ir::reshape_inst* x) {
  * \brief Code Generation for `splat`
  */
 void generator::visit_splat_inst(ir::splat_inst* x) {
-  for(auto idx: idxs_.at(x))
-    vals_[x][idx] = vals_[x->get_operand(0)][{}];
+  Value *arg = vals_[x->get_operand(0)][{}];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++)
+    ret.at(i) = arg;
 }
 
 /**
@@ -1319,10 +1412,11 @@ void generator::visit_exp_inst(ir::exp_inst* x){
   std::vector<llvm::Type*> tys = {f32_ty};
   FunctionType *fn_ty = FunctionType::get(f32_ty, tys, false);
   InlineAsm *ex2 = InlineAsm::get(fn_ty, "ex2.approx.f32 $0, $0;", "=f,0", false);
-  for(auto idx: idxs_.at(x)){
-    Value *ex2arg = fmul(vals_[x->get_operand(0)][idx], log2e);
-    // Value *ex2arg = vals_[x->get_operand(0)][idx];
-    vals_[x][idx] = call(ex2, std::vector<llvm::Value*>{ex2arg});
+  block_values& args = vals_[x->get_operand(0)];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++){
+    Value *ex2arg = fmul(args.at(i), log2e);
+    ret.at(i) = call(ex2, std::vector<llvm::Value*>{ex2arg});
   }
 }
 
@@ -1333,9 +1427,10 @@ void generator::visit_cos_inst(ir::cos_inst* x){
   std::vector<llvm::Type*> tys = {f32_ty};
   FunctionType *fn_ty = FunctionType::get(f32_ty, tys, false);
   InlineAsm *cos = InlineAsm::get(fn_ty, "cos.approx.f32 $0, $0;", "=f,0", false);
-  for(auto idx: idxs_.at(x)){
-    vals_[x][idx] = call(cos, std::vector<llvm::Value*>{vals_[x->get_operand(0)][idx]});
-  }
+  block_values& args = vals_[x->get_operand(0)];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++)
+    ret.at(i) = call(cos, std::vector<llvm::Value*>{args.at(i)});
 }
 
 /**
@@ -1345,11 +1440,11 @@ void generator::visit_umulhi_inst(ir::umulhi_inst* x){
   std::vector<llvm::Type*> tys = {i32_ty, i32_ty};
   FunctionType *fn_ty = FunctionType::get(i32_ty, tys, false);
   InlineAsm *umulhi = InlineAsm::get(fn_ty, "mul.hi.u32 $0, $1, $2;", "=r,r,r", false);
-  for(auto idx: idxs_.at(x)){
-    Value* lhs = vals_[x->get_operand(0)][idx];
-    Value* rhs = vals_[x->get_operand(1)][idx];
-    vals_[x][idx] = call(umulhi, std::vector<llvm::Value*>{lhs, rhs});
-  }
+  block_values& lhs = vals_[x->get_operand(0)];
+  block_values& rhs = vals_[x->get_operand(1)];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++)
+    ret.at(i) = call(umulhi, std::vector<llvm::Value*>{lhs.at(i), rhs.at(i)});
  }
 
 /**
@@ -1359,9 +1454,10 @@ void generator::visit_sin_inst(ir::sin_inst* x){
   std::vector<llvm::Type*> tys = {f32_ty};
   FunctionType *fn_ty = FunctionType::get(f32_ty, tys, false);
   InlineAsm *sin = InlineAsm::get(fn_ty, "sin.approx.f32 $0, $0;", "=f,0", false);
-  for(auto idx: idxs_.at(x)){
-    vals_[x][idx] = call(sin, std::vector<llvm::Value*>{vals_[x->get_operand(0)][idx]});
-  }
+  block_values& args = vals_[x->get_operand(0)];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++)
+    ret.at(i) = call(sin, std::vector<llvm::Value*>{args.at(i)});
  }
 
 /**
@@ -1372,9 +1468,11 @@ void generator::visit_log_inst(ir::log_inst* x){
   std::vector<llvm::Type*> tys = {f32_ty};
   FunctionType *fn_ty = FunctionType::get(f32_ty, tys, false);
   InlineAsm *lg2 = InlineAsm::get(fn_ty, "lg2.approx.f32 $0, $1;", "=f,f", false);
-  for(auto idx: idxs_.at(x)){
-    Value *lg2arg = call(lg2, std::vector<llvm::Value*>{vals_[x->get_operand(0)][idx]});
-    vals_[x][idx] = fmul(lg2arg, rcplog2e);
+  block_values& args = vals_[x->get_operand(0)];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++){
+    Value *lg2arg = call(lg2, std::vector<llvm::Value*>{args.at(i)});
+    ret.at(i) = fmul(lg2arg, rcplog2e);
   }
 }
 
@@ -1648,7 +1746,7 @@ void generator::visit_mma884(ir::dot_inst* C, ir::value *A, ir::value *B, ir::va
 
   // initialize accumulators
   std::vector<Value*> acc;
-  for(indices_t idx: idxs_.at(C))
+  for(const indices_t& idx: idxs_.at(C))
     acc.push_back(vals_[D][idx]);
 
   unsigned num_m = layout_c->rep(0) * shape_c[0] / layout_c->shape_per_cta(0);
@@ -2173,7 +2271,7 @@ private:
 void generator::visit_mma16816(ir::dot_inst* C, ir::value *A, ir::value *B, ir::value *D, unsigned NK) {
   const std::vector<unsigned>& shapes = C->get_type()->get_block_shapes();
   std::map<std::vector<Value*>, std::vector<Value*>> fcs;
-  for(indices_t idx: idxs_.at(C)){
+  for(const indices_t& idx: idxs_.at(C)){
     std::vector<Value*> key(idx.size() - 2);
     std::copy(idx.begin() + 2, idx.end(), key.begin());
     fcs[key].push_back(vals_[D][idx]);
@@ -2479,7 +2577,7 @@ void generator::visit_mma16816(ir::dot_inst* C, ir::value *A, ir::value *B, ir::
   }
   // write back
   unsigned i = 0;
-  for(indices_t idx: idxs_.at(C)){
+  for(const indices_t& idx: idxs_.at(C)){
     std::vector<Value*> key(idx.size() - 2);
     std::copy(idx.begin() + 2, idx.end(), key.begin());
     if(i >= fcs.at(key).size())
@@ -2554,7 +2652,7 @@ void generator::visit_fmadot(ir::dot_inst* C, ir::value* A, ir::value* B, ir::va
   for(int i = 0; i < num_ptr_b; i++)
     ptrs_b[i] = gep(shmems_[B], off_b[i]);
 
-  std::map<indices_t, Value*> ret = vals_[D];
+  block_values ret = vals_[D];
   std::map<std::pair<int, int>, Value*> has, hbs;
   auto ord = layout_c->get_order();
   for(unsigned k = 0; k < NK; k++){
@@ -2582,7 +2680,7 @@ void generator::visit_fmadot(ir::dot_inst* C, ir::value* A, ir::value* B, ir::va
     }
   }
 
-  for(indices_t idx: idxs_.at(C)){
+  for(const indices_t& idx: idxs_.at(C)){
     vals_[C][idx] = ret[idx];
   }
 }
@@ -2622,10 +2720,11 @@ void generator::visit_trans_inst(ir::trans_inst* trans) {
  * \brief Code Generation for `sqrt`
  */
 void generator::visit_sqrt_inst(ir::sqrt_inst* x) {
-  for(indices_t idx: idxs_.at(x)){
-    Value *val = vals_[x->get_operand(0)][idx];
-    Value *ret = intrinsic(Intrinsic::sqrt, {val->getType()}, {val});
-    vals_[x][idx] = ret;
+  block_values& args = vals_[x->get_operand(0)];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++){
+    Value *val = args.at(i);
+    ret.at(i) = intrinsic(Intrinsic::sqrt, {val->getType()}, {val});
   }
 }
 
@@ -2645,8 +2744,15 @@ Value* generator::shared_off(const std::vector<unsigned>& shapes, const std::vec
 inline Value* generator::shfl_sync(Value* acc, int32_t i){
   Type* ty = acc->getType();
   std::string asm_str = "shfl.sync.bfly.b32 $0, $1, $2, 0x1f, 0xffffffff;";
+  size_t n_bits = ty->getPrimitiveSizeInBits();
+  // narrower values are shuffled in a 32-bit register
+  if(n_bits < 32){
+    Type* bits_ty = IntegerType::get(*ctx_, n_bits);
+    Value* ret = shfl_sync(bit_cast(zext(bit_cast(acc, bits_ty), i32_ty), f32_ty), i);
+    return bit_cast(trunc(bit_cast(ret, i32_ty), bits_ty), ty);
+  }
   InlineAsm *shfl = InlineAsm::get(FunctionType::get(ty, {ty, i32_ty}, false), asm_str, "=f,f,r", false);
-  if(ty->getPrimitiveSizeInBits() <= 32)
+  if(n_bits == 32)
     return call(shfl, {acc, i32(i)});
   acc = bit_cast(acc, vec_ty(f32_ty, 2));
   Value* acc0 = builder_->CreateExtractElement(acc, i32(0));
@@ -2658,14 +2764,13 @@ inline Value* generator::shfl_sync(Value* acc, int32_t i){
 }
 
 /**
- * \brief Code Generation for `reduce` (ND case)
+ * \brief Code Generation for `reduce` (ND case, mma layout)
  */
 void generator::visit_reducend_inst_fast(ir::reduce_inst* x, acc_fn_t do_acc, Value *neutral){
   ir::value *arg = x->get_operand(0);
   const auto with_index = x->with_index();
   unsigned axis = x->get_axis();
   analysis::distributed_layout* layout = dynamic_cast<analysis::distributed_layout*>(layouts_->get(arg));
-  const auto &shapes = layout->get_shape();
 
   Type* sca_ty = cvt(arg->get_type()->get_scalar_ty());
   size_t n_bits = sca_ty->getPrimitiveSizeInBits();
@@ -2691,27 +2796,13 @@ void generator::visit_reducend_inst_fast(ir::reduce_inst* x, acc_fn_t do_acc, Va
   Value* warp = udiv(thread, i32(32));
   Value* lane = urem(thread, i32(32));
 
-  unsigned shuffle_width = 0;
-  unsigned warps_per_inner = 0;
+  unsigned shuffle_width = 4;
+  unsigned warps_per_inner = layout->to_mma()->wpt(1);
   auto arg_vals = vals_.at(arg);
-  std::vector<indices_t> arg_idxs = idxs_.at(arg);
+  const std::vector<indices_t>& arg_idxs = idxs_.at(arg);
   size_t n_elts = arg_idxs.size();
-  unsigned col_per_thread = 0;
-  Value* warp_j = nullptr;
-  if (analysis::scanline_layout *scanline = layout->to_scanline()) {
-    std::vector<int> order = layout->get_order();
-    unsigned mts = scanline->mts(order[0]);
-    shuffle_width = std::min<int>(mts, 32);
-    warps_per_inner = std::max<int>(mts / 32, 1);
-    col_per_thread = shapes[order[0]] / mts;
-    warp_j = urem(warp, i32(warps_per_inner));
-  } else if (layout->to_mma()) {
-    shuffle_width = 4;
-    warps_per_inner = layout->to_mma()->wpt(1);
-    col_per_thread = axes_.at(a_axes_->get(arg, 1)).values.size();
-    warp_j = axes_.at(a_axes_->get(arg, 1)).thread_id;
-  } 
-  assert(warp_j != nullptr);
+  unsigned col_per_thread = axes_.at(a_axes_->get(arg, 1)).values.size();
+  Value* warp_j = axes_.at(a_axes_->get(arg, 1)).thread_id;
 
   // unsigned col_per_thread = 2 * shapes[order[0]] / layout->shape_per_cta(order[0]);
   //
@@ -2748,7 +2839,7 @@ void generator::visit_reducend_inst_fast(ir::reduce_inst* x, acc_fn_t do_acc, Va
           [&]() -> Value * { return shfl_sync(acc.second, k); }, false);
     }
     // store partial result to shared memory
-    auto x_idxs = idxs_[x][i];
+    const auto& x_idxs = idxs_[x][i];
     Value* x_idx = x_idxs.empty() ? builder_->getInt32(0) : x_idxs[0];
     // single warp on the reduce dimension -- no need to use shmem
     if(warps_per_inner==1){
@@ -2769,7 +2860,7 @@ void generator::visit_reducend_inst_fast(ir::reduce_inst* x, acc_fn_t do_acc, Va
   // at this point, partial accumulator synchronized in shared memory
   // Just need to reduce `warp_per_inner` numbers in shared memory
   for(size_t i = 0; i < n_elts/col_per_thread; i++){
-    auto x_idxs = idxs_[x][i];
+    const auto& x_idxs = idxs_[x][i];
     Value* x_idx = x_idxs.empty() ? builder_->getInt32(0) : x_idxs[0];
     Value* ld_off = add(mul(x_idx, i32(warps_per_inner)), urem(lane_j, i32(warps_per_inner)));
     std::pair<Value*, Value*> acc;
@@ -2788,6 +2879,124 @@ void generator::visit_reducend_inst_fast(ir::reduce_inst* x, acc_fn_t do_acc, Va
 }
 
 
+/**
+ * \brief Code Generation for `reduce` (ND case, scanline layout)
+ *
+ * Threads of a warp that hold different elements along the axis are reduced
+ * with a butterfly of shuffles. When these threads span several warps, the
+ * partial result of each warp goes through shared memory once, and every
+ * thread reduces the partial results in the same order. Reductions of a
+ * group (see `layouts::reduce_group`) share this exchange.
+ */
+void generator::visit_reducend_inst_shfl(const std::vector<ir::reduce_inst*>& xs) {
+  ir::reduce_inst *x = xs.front();
+  ir::value *arg = x->get_operand(0);
+  unsigned axis = x->get_axis();
+  auto with_index = x->with_index();
+  analysis::scanline_layout* layout = layouts_->get(arg)->to_scanline();
+  int stride = layout->lane_stride(axis);
+  int lanes = layout->lanes_per_warp(axis);
+  int warps = layout->warps_along(axis);
+  size_t n = xs.size();
+  std::vector<acc_fn_t> do_accs(n);
+  for(size_t j = 0; j < n; j++)
+    do_accs[j] = reduce_acc_fn(xs[j]);
+
+  // reduce within thread
+  // index-><current reduced value, current min/max index (optional)>
+  std::vector<std::map<indices_t, std::pair<Value*, Value*>>> accs(n);
+  std::vector<indices_t> pidxs;
+  for(const indices_t& idx: idxs_.at(arg)){
+    indices_t pidx = idx;
+    pidx[axis] = i32(0);
+    bool is_first = accs[0].find(pidx) == accs[0].end();
+    if(is_first)
+      pidxs.push_back(pidx);
+    for(size_t j = 0; j < n; j++){
+      ir::value *arg_j = xs[j]->get_operand(0);
+      do_accs[j](
+          accs[j][pidx], [&]() -> Value * { return vals_[arg_j][idx]; },
+          [&]() -> Value * { return idx[axis]; }, is_first);
+    }
+  }
+
+  // reduce within warp
+  for(size_t j = 0; j < n; j++)
+  for(const indices_t& pidx: pidxs){
+    std::pair<Value *, Value *> &acc = accs[j][pidx];
+    for(int k = lanes/2; k > 0; k >>= 1)
+      do_accs[j](
+          acc, [&]() -> Value * { return shfl_sync(acc.first, k*stride); },
+          [&]() -> Value * { return shfl_sync(acc.second, k*stride); }, false);
+  }
+
+  // reduce across warps
+  // (accesses to shared memory before and after this are ordered by the
+  // membar pass)
+  if(warps > 1){
+    auto *data_layout = layouts_->get(layouts_->tmp(x))->to_shared();
+    auto shape = data_layout->get_shape();
+    auto order = data_layout->get_order();
+    Type *ty = cvt(arg->get_type()->get_scalar_ty());
+    Type *bits_ty = IntegerType::get(*ctx_, ty->getPrimitiveSizeInBits());
+    // values of 32 bits or less are stored with their index in the
+    // upper half of a 64-bit word
+    bool packed = with_index && !layouts_->has_tmp_index(x);
+    Value *data_ptr = cast_shared_layout_ptr(data_layout, cvt(data_layout->get_type()));
+    Value *index_ptr = with_index && !packed
+        ? cast_shared_layout_ptr(layouts_->get(layouts_->tmp_index(x)), i32_ty)
+        : nullptr;
+    // partial results of the j-th reduction are at `j*warps + warp`
+    Value *warp = udiv(axes_.at(a_axes_->get(arg, axis)).thread_id, i32(lanes));
+    for(size_t j = 0; j < n; j++)
+    for(const indices_t& pidx: pidxs){
+      std::pair<Value *, Value *> &acc = accs[j][pidx];
+      indices_t write_idx = pidx;
+      write_idx[axis] = add(warp, i32(j * warps));
+      Value *write_off = shared_off(shape, order, write_idx);
+      if(packed){
+        Value *lo = zext(bit_cast(acc.first, bits_ty), i64_ty);
+        Value *hi = shl(zext(acc.second, i64_ty), i64(32));
+        store(or_(lo, hi), gep(data_ptr, write_off));
+        continue;
+      }
+      store(acc.first, gep(data_ptr, write_off));
+      if(with_index)
+        store(acc.second, gep(index_ptr, write_off));
+    }
+    add_barrier();
+    for(size_t j = 0; j < n; j++)
+    for(const indices_t& pidx: pidxs){
+      std::pair<Value *, Value *> &acc = accs[j][pidx];
+      indices_t read_idx = pidx;
+      for(int w = 0; w < warps; w++){
+        read_idx[axis] = i32(j * warps + w);
+        Value *read_off = shared_off(shape, order, read_idx);
+        Value *word = packed ? load(gep(data_ptr, read_off)) : nullptr;
+        do_accs[j](
+            acc, [&]() -> Value * {
+              return packed ? bit_cast(trunc(word, bits_ty), ty)
+                            : load(gep(data_ptr, read_off)); },
+            [&]() -> Value * {
+              return packed ? trunc(lshr(word, i64(32)), i32_ty)
+                            : load(gep(index_ptr, read_off)); },
+            w == 0);
+      }
+    }
+  }
+
+  // write back
+  for(size_t j = 0; j < n; j++){
+    init_idx(xs[j]);
+    for(const indices_t& idx: idxs_.at(xs[j])){
+      indices_t pidx = idx;
+      pidx.insert(pidx.begin() + axis, i32(0));
+      const std::pair<Value *, Value *> &acc = accs[j].at(pidx);
+      vals_[xs[j]][idx] = with_index ? acc.second : acc.first;
+    }
+  }
+}
+
 void generator::visit_reducend_inst(ir::reduce_inst* x, acc_fn_t do_acc, Value *neutral) {
   ir::value *arg = x->get_operand(0);
   unsigned axis = x->get_axis();
@@ -2796,7 +3005,7 @@ void generator::visit_reducend_inst(ir::reduce_inst* x, acc_fn_t do_acc, Value *
   // reduce within thread
   // index-><current reduced value, current min/max index (optional)>
   std::map<indices_t, std::pair<Value*, Value*>> accs;
-  for(indices_t idx: idxs_.at(arg)){
+  for(const indices_t& idx: idxs_.at(arg)){
     indices_t pidx = idx;
     pidx[axis] = i32(0);
     bool is_first = accs.find(pidx) == accs.end();
@@ -2856,7 +3065,7 @@ void generator::visit_reducend_inst(ir::reduce_inst* x, acc_fn_t do_acc, Value *
   add_barrier();
 
   // write back
-  for(indices_t idx: idxs_.at(x)){
+  for(const indices_t& idx: idxs_.at(x)){
     indices_t read_idx = idx;
     read_idx.insert(read_idx.begin() + axis, i32(0));
     Value *read_off = shared_off(shape, order, read_idx);
@@ -2867,13 +3076,12 @@ void generator::visit_reducend_inst(ir::reduce_inst* x, acc_fn_t do_acc, Value *
 }
 
 /**
- * \brief Code Generation for `reduce` (generic case)
+ * \brief Accumulation function of `reduce`
  */
-void generator::visit_reduce_inst(ir::reduce_inst* x) {
-  Type *ty = cvt(x->get_type()->get_scalar_ty());
-  // accumulation function
+generator::acc_fn_t generator::reduce_acc_fn(ir::reduce_inst* x) {
   ir::reduce_inst::op_t op = x->get_op();
-  auto do_acc_op = [&](Value *x, Value *y) -> Value* {
+  bool with_index = x->with_index();
+  auto do_acc_op = [this, op](Value *x, Value *y) -> Value* {
     switch(op){
     case ir::reduce_inst::ADD: return add(x, y);
     case ir::reduce_inst::SUB: return sub(x, y);
@@ -2897,18 +3105,23 @@ void generator::visit_reduce_inst(ir::reduce_inst* x) {
     }
   };
 
-  auto do_acc = [&](std::pair<Value *, Value *> &acc,
-                    std::function<Value *()> load_value_fn,
-                    std::function<Value *()> load_index_fn,
-                    bool is_first) -> void {
+  return [this, with_index, do_acc_op](std::pair<Value *, Value *> &acc,
+                                       std::function<Value *()> load_value_fn,
+                                       std::function<Value *()> load_index_fn,
+                                       bool is_first) -> void {
     auto *val = load_value_fn();
-    if (x->with_index()) {
+    if (with_index) {
       auto *index = load_index_fn();
       if (is_first) {
         acc.first = val;
         acc.second = index;
       } else {
         Value *ret = do_acc_op(acc.first, val);
+        // ties go to the smallest index, so that the result does not
+        // depend on the order of accumulation
+        Value *eq = val->getType()->isFloatingPointTy() ? fcmp_oeq(acc.first, val)
+                                                        : icmp_eq(acc.first, val);
+        ret = select(eq, icmp_sle(acc.second, index), ret);
         acc.first = select(ret, acc.first, val);
         acc.second = select(ret, acc.second, index);
       }
@@ -2916,6 +3129,19 @@ void generator::visit_reduce_inst(ir::reduce_inst* x) {
       acc.first = is_first ? val : do_acc_op(acc.first, val);
     }
   };
+}
+
+/**
+ * \brief Code Generation for `reduce` (generic case)
+ */
+void generator::visit_reduce_inst(ir::reduce_inst* x) {
+  Type *ty = cvt(x->get_type()->get_scalar_ty());
+  ir::reduce_inst::op_t op = x->get_op();
+  // reductions of a group are lowered together with the first one
+  const std::vector<ir::reduce_inst*>& group = layouts_->reduce_group(x);
+  if(group.front() != x)
+    return;
+  acc_fn_t do_acc = reduce_acc_fn(x);
 
   // neutral element
   Value *neutral;
@@ -2939,24 +3165,24 @@ void generator::visit_reduce_inst(ir::reduce_inst* x) {
     case ir::reduce_inst::XOR: neutral = ConstantInt::get(ty, 0); break;
     default: throw std::runtime_error("unreachable");
   }
-  ir::value *arg = x->get_operand(0);
-  bool is_coalesced_scanline = layouts_->is_coalesced_scanline(x);
-  bool is_a100_mma = layouts_->is_a100_mma(x);
-  if (is_coalesced_scanline || is_a100_mma)
-    visit_reducend_inst_fast(x, do_acc, neutral);
-  else
-    visit_reducend_inst(x, do_acc, neutral);
+  switch(layouts_->reduce_strategy(x)){
+    case analysis::layouts::REDUCE_WARP:
+    case analysis::layouts::REDUCE_WARP_SMEM: visit_reducend_inst_shfl(group); break;
+    case analysis::layouts::REDUCE_MMA: visit_reducend_inst_fast(x, do_acc, neutral); break;
+    default: visit_reducend_inst(x, do_acc, neutral); break;
+  }
 }
 
 /**
  * \brief Code Generation for `select`
  */
 void generator::visit_select_inst(ir::select_inst* x) {
-  for(indices_t idx: idxs_.at(x)){
-    vals_[x][idx] = select(vals_[x->get_operand(0)][idx],
-                           vals_[x->get_operand(1)][idx],
-                           vals_[x->get_operand(2)][idx]);
-  }
+  block_values& preds = vals_[x->get_operand(0)];
+  block_values& if_values = vals_[x->get_operand(1)];
+  block_values& else_values = vals_[x->get_operand(2)];
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++)
+    ret.at(i) = select(preds.at(i), if_values.at(i), else_values.at(i));
 }
 
 
@@ -3301,12 +3527,15 @@ void generator::visit_extern_elementwise_inst(ir::extern_elementwise_inst *i) {
       FunctionType::get(ret_type, std::move(operand_types), false);
   Function *F = llvm::cast<llvm::Function>(
       mod_->getOrInsertFunction(i->get_name(), FT).getCallee());
-  for (auto idx : idxs_.at(i)) {
+  std::vector<block_values*> operands;
+  for (size_t j = 0; j < i->get_num_operands(); j++)
+    operands.push_back(&vals_[i->get_operand(j)]);
+  block_values& ret = vals_[i];
+  for (size_t k = 0; k < ret.size(); k++) {
     std::vector<llvm::Value *> args;
-    for (size_t j = 0; j < i->get_num_operands(); j++) {
-      args.emplace_back(vals_[i->get_operand(j)][idx]);
-    }
-    vals_[i][idx] = call(F, std::move(args));
+    for (block_values* operand : operands)
+      args.emplace_back(operand->at(k));
+    ret.at(k) = call(F, std::move(args));
   }
   add_extern_lib(i->get_lib_name(), i->get_lib_path());
 }
@@ -3341,28 +3570,33 @@ void generator::visit_extern_elementwise_inst(ir::extern_elementwise_inst *i) {
 //}
 
 void generator::visit_make_range(ir::make_range* x) {
-  for(indices_t idx: idxs_.at(x)){
-    Value* start = ConstantInt::get(idx[0]->getType(), x->get_first()->get_value());
-    vals_[x][idx] = add(start, idx[0]);
+  const std::vector<indices_t>& idxs = idxs_.at(x);
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++){
+    Value* start = ConstantInt::get(idxs[i][0]->getType(), x->get_first()->get_value());
+    ret.at(i) = add(start, idxs[i][0]);
   }
 }
 
 void generator::visit_undef_value(ir::undef_value *x) {
   ir::type* sca_ty = x->get_type()->get_scalar_ty();
   Type* ty = cvt(sca_ty);
-  for(indices_t idx: idxs_.at(x))
-    vals_[x][idx] = llvm::UndefValue::get(ty);
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++)
+    ret.at(i) = llvm::UndefValue::get(ty);
 }
 
 void generator::visit_constant_int(ir::constant_int *x){
   Type *ty = cvt(x->get_type()->get_scalar_ty());
-  for(indices_t idx: idxs_.at(x))
-    vals_[x][idx] = ConstantInt::get(ty, x->get_value());
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++)
+    ret.at(i) = ConstantInt::get(ty, x->get_value());
 }
 
 void generator::visit_constant_fp(ir::constant_fp *x){
   Type *ty = cvt(x->get_type()->get_scalar_ty());
-  for(indices_t idx: idxs_.at(x)) {
+  block_values& ret = vals_[x];
+  for(size_t i = 0; i < ret.size(); i++) {
     // manually select bf16 constant
     if (x->get_type()->get_scalar_ty()->is_bf16_ty()) {
       // highest 16 bits of fp32
@@ -3374,9 +3608,9 @@ void generator::visit_constant_fp(ir::constant_fp *x){
       InlineAsm *bf16_const = InlineAsm::get(FunctionType::get(bf16_ty, {}, false),
                                              " mov.b16 $0, " + const_str.str() + ";",
                                              "=h", false);
-      vals_[x][idx] = builder_->CreateCall(bf16_const, {});
+      ret.at(i) = builder_->CreateCall(bf16_const, {});
     } else
-      vals_[x][idx] = ConstantFP::get(ty, x->get_value());
+      ret.at(i) = ConstantFP::get(ty, x->get_value());
   }
 }
 
@@ -3867,12 +4101,10 @@ void generator::finalize_phi_node(ir::phi_node *x) {
   for(unsigned n = 0; n < x->get_num_incoming(); n++){
     ir::basic_block *_block = x->get_incoming_block(n);
     BasicBlock *block = bbs_.at(_block);
-    for(indices_t idx: idxs_.at(x)){
-      PHINode *phi = (PHINode*)vals_[x][idx];
-      Value *inc = vals_[x->get_incoming_value(n)][idx];
-      // x->print(std::cout);
-      phi->addIncoming(inc, block);
-    }
+    block_values& phis = vals_[x];
+    block_values& incs = vals_[x->get_incoming_value(n)];
+    for(size_t i = 0; i < phis.size(); i++)
+      ((PHINode*)phis.at(i))->addIncoming(incs.at(i), block);
   }
 }
 
@@ -3908,8 +4140,19 @@ void generator::visit(ir::module &src, llvm::Module &dst) {
   // visit functions
   for(ir::function *fn: src.get_function_list())
     forward_declare(fn);
-  for(ir::function *fn: src.get_function_list())
+  for(ir::function *fn: src.get_function_list()){
+    auto start = std::chrono::steady_clock::now();
     visit_function(fn);
+    if(!tools::getenv("TRITON_CODEGEN_STATS").empty()){
+      std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      size_t num_insts = 0;
+      for(ir::basic_block *block: fn->blocks())
+        num_insts += block->get_inst_list().size();
+      std::cerr << "selection: " << fn->get_name() << ": "
+                << elapsed.count() << " ms, "
+                << num_insts << " instruction(s)" << std::endl;
+    }
+  }
 }
 
 void generator::add_extern_lib(const std::string &lib_name,
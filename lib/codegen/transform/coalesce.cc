@@ -15,6 +15,64 @@ namespace transform{
 coalesce::coalesce(analysis::align* align, analysis::layouts *layouts, bool has_sm80)
   : align_(align), layout_(layouts), has_sm80_(has_sm80) { }
 
+// mask of a masked load/store, if any
+static ir::value* get_mask(ir::io_inst* i) {
+  if(auto x = dynamic_cast<ir::masked_load_inst*>(i))
+    return x->get_mask_operand();
+  if(auto x = dynamic_cast<ir::masked_store_inst*>(i))
+    return x->get_mask_operand();
+  return nullptr;
+}
+
+// Accessing global memory straight from the MMA layout: each thread owns
+// pairs of adjacent columns and the 4 threads of a quad cover 8 adjacent
+// columns of a row, so a quad touches at most 8 contiguous elements.
+// This mirrors the vector width computed by the generator.
+double coalesce::direct_io_cost(ir::io_inst* i, ir::value* val) {
+  analysis::mma_layout* layout = layout_->get(val)->to_mma();
+  ir::value* ptr = i->get_pointer_operand();
+  int axis = layout->get_order(0);
+  size_t num_elements = val->get_type()->get_tile_num_elements();
+  size_t dtsize = std::max<int>(1, val->get_type()->get_scalar_ty()->get_primitive_size_in_bits() / 8);
+  unsigned aln = align_->get(ptr, axis);
+  unsigned contig = align_->contiguous(ptr)[axis];
+  if(ir::value* mask = get_mask(i)){
+    unsigned max_eq = std::max<unsigned>(1, align_->get_cst_info(mask)[axis].num_cst);
+    aln = std::min(aln, max_eq);
+    contig = std::min(contig, max_eq);
+  }
+  unsigned vec = std::min<unsigned>(layout->contig_per_thread(axis), aln);
+  // bytes actually used in each sector touched by a quad
+  unsigned seg = std::min<unsigned>(contig, quad_size * layout->contig_per_thread(axis)) * dtsize;
+  double efficiency = (double)seg / (sector_bytes * ((seg + sector_bytes - 1) / sector_bytes));
+  double bytes = num_elements * dtsize;
+  return bytes / efficiency + mem_inst_cost * num_elements / vec;
+}
+
+// Converting to a blocked layout first: one shared memory round trip
+// fenced by barriers, after which accesses are fully coalesced and use
+// up to 128-bit vectors
+double coalesce::converted_io_cost(ir::io_inst* i, ir::value* val) {
+  analysis::mma_layout* layout = layout_->get(val)->to_mma();
+  ir::value* ptr = i->get_pointer_operand();
+  std::vector<unsigned> contig = align_->contiguous(ptr);
+  size_t num_elements = val->get_type()->get_tile_num_elements();
+  size_t dtsize = std::max<int>(1, val->get_type()->get_scalar_ty()->get_primitive_size_in_bits() / 8);
+  unsigned max_contig = *std::max_element(contig.begin(), contig.end());
+  unsigned vec = std::max<unsigned>(1, std::min<unsigned>(max_contig, max_vector_bytes / dtsize));
+  double bytes = num_elements * dtsize;
+  return bytes + 2 * smem_byte_cost * bytes + 2 * barrier_cost
+         + mem_inst_cost * num_elements / vec
+         + mem_inst_cost * num_elements / layout->contig_per_thread(layout->get_order(0));
+}
+
+bool coalesce::is_direct_io_profitable(ir::io_inst* i, ir::value* val) {
+  // the generator only vectorizes accesses in the Ampere MMA layout
+  if(!has_sm80_)
+    return false;
+  return direct_io_cost(i, val) <= converted_io_cost(i, val);
+}
+
 void coalesce::run(ir::module &mod) {
   std::set<analysis::data_layout*> invalidated;
   ir::builder& builder = mod.get_builder();
@@ -29,7 +87,8 @@ void coalesce::run(ir::module &mod) {
     if(op->get_type()->get_tile_ranks1() == 2)
     if(invalidated.find(layout_->get(op)) == invalidated.end())
     if(layout_->get(op)->to_mma())
-    if(dynamic_cast<ir::io_inst*>(i)->get_eviction_policy()==ir::io_inst::NORMAL){
+    if(dynamic_cast<ir::io_inst*>(i)->get_eviction_policy()==ir::io_inst::NORMAL)
+    if(!is_direct_io_profitable(dynamic_cast<ir::io_inst*>(i), op)){
       ir::instruction* new_op = ir::cvt_layout_inst::create(op);
       builder.set_insert_point(i);
       builder.insert(new_op);
@@ -57,7 +116,8 @@ void coalesce::run(ir::module &mod) {
     if(x->get_type()->is_block_ty())
     if(x->get_type()->get_tile_ranks1()==2)
     if(layout_->get(x)->to_mma())
-    if(!has_sm80_ || dynamic_cast<ir::io_inst*>(i)->get_eviction_policy()==ir::io_inst::NORMAL){
+    if(!has_sm80_ || dynamic_cast<ir::io_inst*>(i)->get_eviction_policy()==ir::io_inst::NORMAL)
+    if(!is_direct_io_profitable(x, x)){
         builder.set_insert_point_after(x);
         ir::instruction* new_x = ir::cvt_layout_inst::create(x);
         builder.insert(new_x);
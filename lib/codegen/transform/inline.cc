@@ -1,4 +1,6 @@
 #include <iostream>
+#include <functional>
+#include <set>
 #include "triton/codegen/transform/inline.h"
 #include "triton/ir/module.h"
 #include "triton/ir/function.h"
@@ -90,36 +92,45 @@ void inliner::do_inline(ir::function* fn, ir::call_inst* callsite, ir::builder&
 }
 
 void inliner::run(ir::module &mod) {
-
-  // gather all call sites
-  while(true){
-    std::map<ir::function*, size_t> counts;
-    for(ir::function* fn: mod.get_function_list())
-      counts[fn] = 0;
-
-    std::list<ir::call_inst*> callsites;
-    for(ir::function* fn: mod.get_function_list()){
-      for(ir::basic_block* block: fn->blocks())
-      for(ir::instruction* instr: block->get_inst_list())
-      if(ir::call_inst* call = dynamic_cast<ir::call_inst*>(instr)){
-        callsites.push_back(call);
-        counts[call->get_fn()] += 1;
-      }
-    }
-
-    for(auto& count: counts){
-      if(!count.first->get_is_kernel() && count.second == 0)
-        count.first->get_parent()->remove_function(count.first);
-    }
-
-    if(callsites.empty())
-      break;
-
-    for(ir::call_inst* call: callsites)
-      do_inline(call->get_fn(), call, mod.get_builder(), callsites);
+  // call graph
+  std::map<ir::function*, std::vector<ir::call_inst*>> callsites;
+  for(ir::function* fn: mod.get_function_list())
+  for(ir::basic_block* block: fn->blocks())
+  for(ir::instruction* instr: block->get_inst_list())
+  if(ir::call_inst* call = dynamic_cast<ir::call_inst*>(instr))
+    callsites[fn].push_back(call);
+  // bottom-up order: callees come before their callers, so that
+  // every call site is inlined exactly once with a body that has
+  // no call left in it
+  std::vector<ir::function*> order;
+  std::set<ir::function*> done;
+  std::set<ir::function*> visiting;
+  std::function<void(ir::function*)> visit = [&](ir::function* fn){
+    if(done.find(fn) != done.end())
+      return;
+    if(!visiting.insert(fn).second)
+      throw std::runtime_error("recursive call to " + fn->get_name() + " is not supported");
+    for(ir::call_inst* call: callsites[fn])
+      visit(call->get_fn());
+    visiting.erase(fn);
+    done.insert(fn);
+    order.push_back(fn);
+  };
+  for(ir::function* fn: mod.get_function_list())
+    visit(fn);
+  // instruction selection has no calling convention for block values,
+  // so Triton-IR calls are always inlined. Large extern device functions
+  // may still be kept out-of-line at the LLVM level (see link_extern_libs)
+  for(ir::function* fn: order){
+    std::list<ir::call_inst*> calls(callsites[fn].begin(), callsites[fn].end());
+    for(ir::call_inst* call: callsites[fn])
+      do_inline(call->get_fn(), call, mod.get_builder(), calls);
   }
-
-
+  // remove device functions
+  std::vector<ir::function*> fns = mod.get_function_list();
+  for(ir::function* fn: fns)
+    if(!fn->get_is_kernel())
+      mod.remove_function(fn);
 }
 
 }
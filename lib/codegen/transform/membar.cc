@@ -1,6 +1,7 @@
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <iostream>
 #include "triton/codegen/analysis/layout.h"
 #include "triton/codegen/analysis/allocation.h"
 #include "triton/codegen/transform/membar.h"
@@ -10,6 +11,7 @@
 #include "triton/ir/basic_block.h"
 #include "triton/ir/instructions.h"
 #include "triton/ir/utils.h"
+#include "triton/tools/sys/getenv.hpp"
 
 namespace triton {
 
@@ -44,47 +46,62 @@ int membar::group_of(ir::value* v, std::vector<ir::value*> &async_write) {
   }
 }
 
-inline bool membar::intersect_with(analysis::shared_layout* a_layout, analysis::shared_layout* b_layout) {
-  if(!a_layout || !b_layout)
-    return false;
-  int a_start = alloc_->offset(a_layout);
-  int a_end = a_start + a_layout->get_size();
-  int b_start = alloc_->offset(b_layout);
-  int b_end = b_start + b_layout->get_size();
-  if(a_start < b_end || b_start < a_end)
-    return true;
+// shared memory byte ranges occupied by `v` and its scratch buffers
+void membar::get_intervals(ir::value* v, std::vector<interval_t>& intervals) {
+  if(!v->get_type()->is_block_ty())
+    return;
+  std::vector<analysis::data_layout*> buffers = {layouts_->get(v)};
+  if(layouts_->has_tmp(v))
+    buffers.push_back(layouts_->get(layouts_->tmp(v)));
+  if(layouts_->has_tmp_index(v))
+    buffers.push_back(layouts_->get(layouts_->tmp_index(v)));
+  for(analysis::data_layout* x: buffers){
+    analysis::shared_layout* layout = x->to_shared();
+    if(!layout)
+      continue;
+    unsigned start = alloc_->offset(layout);
+    intervals.push_back({start, start + layout->get_size()});
+  }
+}
+
+// two values conflict only when their shared memory ranges overlap;
+// buffers whose live ranges never overlap may still share bytes, in
+// which case the allocation makes them intersect here
+bool membar::intersect_with(ir::value* a, ir::value* b) {
+  std::vector<interval_t> as, bs;
+  get_intervals(a, as);
+  get_intervals(b, bs);
+  for(const interval_t& x: as)
+  for(const interval_t& y: bs)
+    if(x.first < y.second && y.first < x.second)
+      return true;
   return false;
 }
 
 membar::val_set_t membar::intersect_with(const val_set_t& as, const val_set_t& bs) {
   val_set_t ret;
-  for(ir::value* a: as){
-    if(!a->get_type()->is_block_ty())
-      continue;
-    analysis::shared_layout* a_layout = layouts_->get(a)->to_shared();
-    analysis::shared_layout* a_tmp = layouts_->has_tmp(a) ? layouts_->get(layouts_->tmp(a))->to_shared() : nullptr;
-    analysis::shared_layout* a_tmp_index = layouts_->has_tmp_index(a) ? layouts_->get(layouts_->tmp_index(a))->to_shared() : nullptr;
-    for(ir::value* b: bs){
-      if(!b->get_type()->is_block_ty())
-        continue;
-      analysis::shared_layout* b_layout = layouts_->get(b)->to_shared();
-      analysis::shared_layout* b_tmp = layouts_->has_tmp(b) ? layouts_->get(layouts_->tmp(b))->to_shared() : nullptr;
-      analysis::shared_layout* b_tmp_index = layouts_->has_tmp_index(b) ? layouts_->get(layouts_->tmp_index(b))->to_shared() : nullptr;
-      if(intersect_with(a_layout, b_layout) ||
-         intersect_with(a_layout, b_tmp) ||
-         intersect_with(a_layout, b_tmp_index) ||
-         intersect_with(a_tmp, b_layout) ||
-         intersect_with(a_tmp, b_tmp) ||
-         intersect_with(a_tmp, b_tmp_index) ||
-         intersect_with(a_tmp_index, b_layout) ||
-         intersect_with(a_tmp_index, b_tmp) ||
-         intersect_with(a_tmp_index, b_tmp_index))
-        ret.insert(b);
-    }
-  }
+  for(ir::value* a: as)
+  for(ir::value* b: bs)
+    if(intersect_with(a, b))
+      ret.insert(b);
   return ret;
 }
 
+bool membar::touches_shared(ir::instruction* i) {
+  if(dynamic_cast<ir::masked_load_async_inst*>(i) ||
+     dynamic_cast<ir::copy_to_shared_inst*>(i) ||
+     dynamic_cast<ir::prefetch_s_inst*>(i))
+    return true;
+  if(layouts_->has_tmp(i) || layouts_->has_tmp_index(i))
+    return true;
+  if(i->get_type()->is_block_ty() && layouts_->get(i)->to_shared())
+    return true;
+  for(ir::value* op: i->ops())
+    if(op->get_type()->is_block_ty() && layouts_->get(op)->to_shared())
+      return true;
+  return false;
+}
+
 bool membar::check_safe_war(ir::instruction* i) {
   bool is_i_shared_block = i->get_type()->is_block_ty() &&
                           layouts_->get(i)->to_shared();
@@ -109,19 +126,29 @@ void membar::transfer(ir::basic_block *block,
                       val_set_t& sync_read,
                       std::set<ir::value*>& safe_war,
                       bool& inserted, ir::builder& builder) {
-  std::vector<ir::async_wait_inst*> async_waits;
+  // most recent async_wait (immediately followed by a barrier) in this block
+  // with no asynchronous copy issued since; it can be strengthened instead
+  // of emitting a new wait + barrier pair
+  ir::async_wait_inst* last_async_wait = nullptr;
   ir::basic_block::inst_list_t instructions = block->get_inst_list();
-  for(ir::instruction *i: instructions){
+  for(auto it = instructions.begin(); it != instructions.end(); ++it){
+    ir::instruction *i = *it;
     if(dynamic_cast<ir::phi_node*>(i))
       continue;
     if(std::find(async_write.begin(), async_write.end(), i) == async_write.end() &&
        dynamic_cast<ir::masked_load_async_inst*>(i)){
       async_write.push_back(i);
     }
+    if(dynamic_cast<ir::masked_load_async_inst*>(i))
+      last_async_wait = nullptr;
     if(dynamic_cast<ir::copy_to_shared_inst*>(i))
       sync_write.insert(i);
     ir::barrier_inst* barrier = dynamic_cast<ir::barrier_inst*>(i);
     ir::async_wait_inst* async_wait = dynamic_cast<ir::async_wait_inst*>(i);
+    if(async_wait){
+      auto next = std::next(it);
+      last_async_wait = (next != instructions.end() && dynamic_cast<ir::barrier_inst*>(*next)) ? async_wait : nullptr;
+    }
     // Get shared memory reads
     std::set<ir::value*> read;
     std::copy_if(i->op_begin(), i->op_end(), std::inserter(read, read.begin()),
@@ -136,20 +163,36 @@ void membar::transfer(ir::basic_block *block,
       std::transform(read.begin(), read.end(), groups.begin(), [&](ir::value* v){ return group_of(v, async_write);});
       int N = *std::max_element(groups.begin(), groups.end());
       if(N < async_write.size()){
-        builder.set_insert_point(i);
-        async_wait = (ir::async_wait_inst*)builder.create_async_wait(async_write.size() - 1 - N);
-        barrier = (ir::barrier_inst*)builder.create_barrier();
-        inserted = true;
-        async_waits.push_back(async_wait);
+        int n_wait = async_write.size() - 1 - N;
+        if(last_async_wait){
+          // nothing was issued since the previous wait: waiting for more
+          // groups there is equivalent and saves a barrier
+          if(n_wait < last_async_wait->get_N()){
+            last_async_wait->set_N(n_wait);
+            inserted = true;
+          }
+          async_wait = last_async_wait;
+        }
+        else{
+          builder.set_insert_point(i);
+          async_wait = (ir::async_wait_inst*)builder.create_async_wait(n_wait);
+          barrier = (ir::barrier_inst*)builder.create_barrier();
+          last_async_wait = async_wait;
+          inserted_.insert(async_wait);
+          inserted_.insert(barrier);
+          inserted = true;
+        }
       }
     }
     // RAW, WAR
     bool is_safe_war = check_safe_war(i);
     // WAR barrier is not required when data is double-buffered
-    if(!intersect_with(read, sync_write).empty() || 
-       (!intersect_with({i}, sync_read).empty() && !is_safe_war)) {
+    if(!barrier &&
+       (!intersect_with(read, sync_write).empty() ||
+       (!intersect_with({i}, sync_read).empty() && !is_safe_war))) {
       builder.set_insert_point(i);
       barrier = (ir::barrier_inst*)builder.create_barrier();
+      inserted_.insert(barrier);
       inserted = true;
     }
     // update state of asynchronous copies
@@ -164,41 +207,62 @@ void membar::transfer(ir::basic_block *block,
     }
     sync_read.insert(read.begin(), read.end());
   }
+}
 
-  // coalesce barriers
-  // fixme: to support more general cases
-  if (async_waits.size() == 2) {
-    // (aw N; bar; prefetch; aw N-1; bar; prefetch; => aw N-1; bar; 2*prefetch;)
-    for (int idx=0; idx<async_waits.size()-1; ++idx) {
-      ir::async_wait_inst *first_async_wait = async_waits[idx];
-      std::vector<ir::instruction*> to_erase;
-      ir::basic_block::inst_list_t instructions = block->get_inst_list();
-      for(auto iter = instructions.begin(); iter != instructions.end(); ++iter){
-        ir::instruction *i = *iter;
-        if (static_cast<ir::instruction*>(first_async_wait) == i) {
-          // peak next 5 instructions
-          auto peak_iter = std::next(iter);
-          if (std::distance(peak_iter, instructions.end()) >= 5) {
-            auto first_bar = dynamic_cast<ir::barrier_inst*>(*peak_iter++);
-            auto first_pf = dynamic_cast<ir::prefetch_s_inst*>(*peak_iter++);
-            auto second_async_wait = dynamic_cast<ir::async_wait_inst*>(*peak_iter++);
-            auto second_bar = dynamic_cast<ir::barrier_inst*>(*peak_iter++);
-            auto second_pf = dynamic_cast<ir::prefetch_s_inst*>(*peak_iter);
-            if (first_bar && first_pf && second_async_wait && second_bar && second_pf) {
-              int first_n = first_async_wait->get_N();
-              int second_n = second_async_wait->get_N();
-              to_erase.push_back(second_async_wait);
-              to_erase.push_back(second_bar);
-              first_async_wait->set_N(second_n);
-            }
-          } else 
-            break;
-          for (ir::instruction *i : to_erase)
-            block->erase(i);
-        }
+// Local cleanup once the dataflow analysis has converged:
+//  - two async_waits with no asynchronous copy issued in between are merged
+//    into the first one (keeping the stronger wait). The barrier following
+//    the second one is dropped too; if it was also needed to order
+//    synchronous accesses, the next round of the analysis puts it back
+//    right before the first conflicting instruction
+//  - a barrier is erased when no instruction touched shared memory since
+//    the previous barrier of the block (an async_wait counts as a write)
+// Returns the number of erased instructions; only those that were in the
+// kernel before this pass count as removed
+int membar::coalesce(ir::basic_block *block) {
+  std::vector<ir::instruction*> to_erase;
+  ir::async_wait_inst* prev_wait = nullptr;
+  bool has_prev_barrier = false;
+  bool touched = false;
+  ir::basic_block::inst_list_t instructions = block->get_inst_list();
+  for(auto it = instructions.begin(); it != instructions.end(); ++it){
+    ir::instruction* i = *it;
+    if(dynamic_cast<ir::phi_node*>(i))
+      continue;
+    if(auto wait = dynamic_cast<ir::async_wait_inst*>(i)){
+      if(!prev_wait){
+        // the barrier that follows makes the data it waited for
+        // visible to all threads, so it is never redundant
+        prev_wait = wait;
+        touched = true;
+        continue;
+      }
+      prev_wait->set_N(std::min(prev_wait->get_N(), wait->get_N()));
+      to_erase.push_back(wait);
+      auto next = std::next(it);
+      if(next != instructions.end() && dynamic_cast<ir::barrier_inst*>(*next)){
+        to_erase.push_back(*next);
+        ++it;
       }
+      continue;
+    }
+    if(dynamic_cast<ir::barrier_inst*>(i)){
+      if(has_prev_barrier && !touched)
+        to_erase.push_back(i);
+      has_prev_barrier = true;
+      touched = false;
+      continue;
     }
+    if(dynamic_cast<ir::masked_load_async_inst*>(i))
+      prev_wait = nullptr;
+    touched = touched || touches_shared(i);
+  }
+  for(ir::instruction* i: to_erase){
+    if(!inserted_.erase(i))
+      num_removed_++;
+    block->erase(i);
   }
+  return to_erase.size();
 }
 
 void membar::run(ir::module &mod) {
@@ -223,6 +287,8 @@ void membar::run(ir::module &mod) {
     std::map<ir::basic_block*, val_set_t> sync_writes;
     std::map<ir::basic_block*, val_set_t> sync_reads;
     std::list<ir::value *> pipelined;
+    inserted_.clear();
+    num_removed_ = 0;
     bool inserted;
     do{
       inserted = false;
@@ -245,7 +311,21 @@ void membar::run(ir::module &mod) {
         sync_writes[block] = sync_write;
         sync_reads[block] = sync_read;
       }
+      // merge redundant synchronization and re-run the analysis
+      // in case some of it has to be re-inserted elsewhere
+      if(!inserted)
+        for(ir::basic_block *block: rpo)
+          inserted = coalesce(block) > 0 || inserted;
     }while(inserted);
+    // a barrier erased and put back by a later round is only counted
+    // once: what remains of this pass' insertions after the fixpoint
+    int num_inserted = std::count_if(inserted_.begin(), inserted_.end(),
+                                     [](ir::instruction* i){ return dynamic_cast<ir::barrier_inst*>(i); });
+    stats_[fn] = {num_inserted, num_removed_};
+    if(!tools::getenv("TRITON_CODEGEN_STATS").empty())
+      std::cerr << "membar: " << fn->get_name() << ": "
+                << num_inserted << " barrier(s) inserted, "
+                << num_removed_ << " barrier(s)/async wait(s) removed" << std::endl;
   }
 }
 
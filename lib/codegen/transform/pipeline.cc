@@ -105,39 +105,84 @@ struct pipeline_info_t {
   ir::load_inst* load;
   ir::phi_node* ptr;
   ir::dot_inst* dot;
+  int num_stages;
 
-  pipeline_info_t(ir::load_inst* load, ir::phi_node* ptr, ir::dot_inst* dot)
-    : load(load), ptr(ptr), dot(dot) {}
+  pipeline_info_t(ir::load_inst* load, ir::phi_node* ptr, ir::dot_inst* dot, int num_stages)
+    : load(load), ptr(ptr), dot(dot), num_stages(num_stages) {}
 };
 
+/// checks that a load which does not feed a dot sits in a single-block
+/// loop of the shape expected by the rewrite below
+static bool is_pipelinable_non_dot(ir::load_inst* load, ir::phi_node* ptr) {
+  if(!load->get_type()->is_block_ty() || load->get_is_volatile())
+    return false;
+  if(load->get_users().empty())
+    return false;
+  ir::basic_block* block = ptr->get_parent();
+  if(load->get_parent() != block)
+    return false;
+  auto preds = block->get_predecessors();
+  if(preds.size() != 2 || ptr->get_incoming_block(0) != preds[0])
+    return false;
+  ir::basic_block* header = preds[0];
+  return dynamic_cast<ir::cond_branch_inst*>(block->get_inst_list().back()) &&
+         dynamic_cast<ir::cond_branch_inst*>(header->get_inst_list().back());
+}
+
+int pipeline::get_num_stages(ir::load_inst* load, bool is_dot_operand) {
+  // dot operands are staged through shared memory
+  if(is_dot_operand)
+    return num_stages_;
+  // other loads are prefetched into registers: every additional stage
+  // keeps one more copy of the tile alive in each thread
+  ir::type* ty = load->get_type();
+  int num_threads = num_warps_ * 32;
+  int bytes = ty->get_tile_num_elements() * ty->get_scalar_ty()->get_primitive_size_in_bits() / 8;
+  int bytes_per_thread = std::max(1, bytes / num_threads);
+  int num_stages = std::min(num_stages_, 1 + max_prefetch_bytes_per_thread / bytes_per_thread);
+  // loads of iteration i+2 and beyond would be hoisted above the
+  // stores of iteration i+1, which may alias them
+  for(ir::instruction* i: load->get_parent()->get_inst_list())
+    if(dynamic_cast<ir::store_inst*>(i) || dynamic_cast<ir::atomic_inst*>(i))
+      num_stages = std::min(num_stages, 2);
+  return num_stages;
+}
+
 void pipeline::run(ir::module &mod) {
   if (num_stages_ <= 1)
     return;
-  // *Very* conservative heuristics for pre-fetching.
   // A load instruction can be pipelined if:
   //   - the pointer is a phi node that references a value
   //     in its basic block (i.e., pointer induction variable)
-  //   - the load has only  a single use in a dot instruction
-  // As more use cases become apparent, this pass will be improved
+  //   - the load either has a single use in a dot instruction, in
+  //     which case it is staged through shared memory, or it is a
+  //     block load of the loop body, in which case it is prefetched
+  //     into registers as long as `get_num_stages` deems it cheap enough
   std::vector<pipeline_info_t> to_pipeline;
   ir::for_each_instruction(mod, [&](ir::instruction *i){
     if(auto* load = dynamic_cast<ir::load_inst*>(i)){
       ir::phi_node* ptr = dynamic_cast<ir::phi_node*>(load->get_pointer_operand());
+      if(!ptr || ptr->get_incoming_block(1) != ptr->get_parent())
+        return;
       auto users = load->get_users();
-      auto dot = dynamic_cast<ir::dot_inst*>(*users.begin());
-      if(ptr && ptr->get_incoming_block(1) == ptr->get_parent()
-         && users.size() == 1 && dot)
-        to_pipeline.push_back({load, ptr, dot});
+      ir::dot_inst* dot = nullptr;
+      if(users.size() == 1)
+        dot = dynamic_cast<ir::dot_inst*>(*users.begin());
+      if(!dot && !is_pipelinable_non_dot(load, ptr))
+        return;
+      int num_stages = get_num_stages(load, dot != nullptr);
+      if(num_stages > 1)
+        to_pipeline.push_back({load, ptr, dot, num_stages});
     }});
   // do the pipelining
   std::vector<ir::phi_node*> new_loads;
   ir::builder &builder = mod.get_builder();
-  const int num_stages = num_stages_;
   std::vector<std::pair<ir::phi_node*, std::vector<ir::value*>>> preheader_loads; // Used to reorder loads
 
   for(auto info: to_pipeline){
     ir::load_inst* load = info.load;
     ir::phi_node* ptr   = info.ptr;
+    const int num_stages = info.num_stages;
     ir::basic_block* block = load->get_parent();
     ir::basic_block* header = block->get_predecessors()[0];
     auto* block_br = dynamic_cast<ir::cond_branch_inst*>(block->get_inst_list().back());
@@ -146,7 +191,8 @@ void pipeline::run(ir::module &mod) {
     assert(header_br);
     ir::type* ty = load->get_type();
     // multi-stage pipe
-    if (has_copy_async_ && num_stages > 2) {
+    // (register prefetching does not need asynchronous copies)
+    if ((has_copy_async_ || !info.dot) && num_stages > 2) {
       ir::value* header_cond = header_br->get_cond();
       ir::value* block_cond = block_br->get_cond();
       // 1. collect induction variables
@@ -282,16 +328,20 @@ void pipeline::run(ir::module &mod) {
 
   // try to reorder prefetched value from a0, a1, a2, ..., b0, b1, b2, ...  to
   // a0, b0, a1, b1, ...
-  if (!preheader_loads.empty()) {
-    ir::basic_block* header = preheader_loads.begin()->first->get_incoming_block(0);
-    builder.set_insert_point(header->get_inst_list().back());
-    for (int i=1; i<num_stages-1; ++i) {
-      for (auto iter = preheader_loads.begin(); iter != preheader_loads.end(); ++iter) {
-        ir::instruction* original_load = static_cast<ir::instruction*>(iter->second.at(i));
-        ir::instruction* moved_load = original_load->clone();
-        builder.insert(moved_load);
-        original_load->replace_all_uses_with(moved_load);
-      }
+  // (loads may now belong to different loops and have different depths)
+  size_t max_prefetched = 0;
+  for (auto& x : preheader_loads)
+    max_prefetched = std::max(max_prefetched, x.second.size());
+  for (size_t i=1; i<max_prefetched; ++i) {
+    for (auto iter = preheader_loads.begin(); iter != preheader_loads.end(); ++iter) {
+      if (i >= iter->second.size())
+        continue;
+      ir::basic_block* header = iter->first->get_incoming_block(0);
+      builder.set_insert_point(header->get_inst_list().back());
+      ir::instruction* original_load = static_cast<ir::instruction*>(iter->second.at(i));
+      ir::instruction* moved_load = original_load->clone();
+      builder.insert(moved_load);
+      original_load->replace_all_uses_with(moved_load);
     }
   }
 
@@ -301,17 +351,17 @@ void pipeline::run(ir::module &mod) {
     std::vector<ir::instruction*> insts;
     ir::load_inst* dst;
   };
-  std::vector<move_config_t> to_move(to_pipeline.size());
+  std::vector<move_config_t> to_move;
 
   if(has_copy_async_){
-    for (size_t idx = 0; idx < to_pipeline.size(); ++idx) {
-      auto info = to_pipeline[idx];
-      ir::load_inst* load = info.load;
-      ir::phi_node* ptr = info.ptr;
+    for (auto info : to_pipeline) {
       ir::dot_inst* dot = info.dot;
-      ir::basic_block* bb = dot->get_parent();
-      recursive_deps(dot, bb, to_move[idx].insts);
-      to_move[idx].dst = load;
+      if (!dot)
+        continue;
+      move_config_t config;
+      recursive_deps(dot, dot->get_parent(), config.insts);
+      config.dst = info.load;
+      to_move.push_back(config);
     }
 
     for(auto& move_config: to_move){
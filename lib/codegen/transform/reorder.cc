@@ -1,49 +1,83 @@
 #include <iostream>
 #include <algorithm>
+#include <set>
 #include "triton/ir/module.h"
 #include "triton/ir/function.h"
 #include "triton/ir/basic_block.h"
 #include "triton/ir/instructions.h"
+#include "triton/codegen/analysis/layout.h"
 #include "triton/codegen/transform/reorder.h"
 
 namespace triton {
 namespace codegen{
 namespace transform{
 
-void reorder::run(ir::module& mod){
-//    ir::builder &builder = mod.get_builder();
-//    std::vector<std::pair<ir::instruction*, ir::value*>> to_replace;
-
-//    for(ir::function *fn: mod.get_function_list())
-//    for(ir::basic_block *block: fn->blocks())
-//    for(ir::instruction* i: block->get_inst_list()){
-//      if(auto* ld = dynamic_cast<ir::masked_load_inst*>(i)){
-//        ir::value* _ptr = ld->get_pointer_operand();
-//        ir::value* _msk = ld->get_mask_operand();
-//        ir::value* _val = ld->get_false_value_operand();
-//        auto ptr = std::find(block->begin(), block->end(), _ptr);
-//        auto msk = std::find(block->begin(), block->end(), _msk);
-//        auto val = std::find(block->begin(), block->end(), _val);
-//        if(ptr == block->end() || msk == block->end() || val == block->end())
-//          continue;
-//        auto it = std::find(block->begin(), block->end(), i);
-//        int dist_ptr = std::distance(ptr, it);
-//        int dist_msk = std::distance(msk, it);
-//        int dist_val = std::distance(val, it);
-//        if(dist_ptr < dist_msk && dist_ptr < dist_val)
-//          builder.set_insert_point(++ptr);
-//        if(dist_msk < dist_ptr && dist_msk < dist_val)
-//          builder.set_insert_point(++msk);
-//        if(dist_val < dist_ptr && dist_val < dist_msk)
-//          builder.set_insert_point(++val);
-//        ir::value* new_ld = builder.create_masked_load(_ptr, _msk, _val);
-//        to_replace.push_back(std::make_pair(ld, new_ld));
-//      }
-//    }
-
-//    for(auto& x: to_replace)
-//      x.first->replace_all_uses_with(x.second);
+// instructions without side effects that are cheap to move
+bool reorder::is_movable(ir::instruction* i) {
+  return dynamic_cast<ir::binary_operator*>(i) ||
+         dynamic_cast<ir::cmp_inst*>(i) ||
+         dynamic_cast<ir::cast_inst*>(i) ||
+         dynamic_cast<ir::retile_inst*>(i) ||
+         dynamic_cast<ir::getelementptr_inst*>(i) ||
+         dynamic_cast<ir::select_inst*>(i) ||
+         dynamic_cast<ir::exp_inst*>(i) ||
+         dynamic_cast<ir::log_inst*>(i) ||
+         dynamic_cast<ir::sqrt_inst*>(i) ||
+         dynamic_cast<ir::cos_inst*>(i) ||
+         dynamic_cast<ir::sin_inst*>(i) ||
+         dynamic_cast<ir::reduce_inst*>(i);
+}
 
+// A group of consecutive reductions is moved down to the next reduction it
+// can be fused with, together with the instructions in between that use
+// their results. This is done only when these instructions can be moved and
+// the next reduction does not depend on them, e.g.
+//   %a = reduce %x              %c = mul %x, %x
+//   %b = fdiv %a, %n     -->    %d = reduce %c
+//   %c = mul %x, %x             %a = reduce %x
+//   %d = reduce %c              %b = fdiv %a, %n
+void reorder::run(ir::module& mod){
+  for(ir::function *fn: mod.get_function_list())
+  for(ir::basic_block *block: fn->blocks()){
+    ir::basic_block::inst_list_t &insts = block->get_inst_list();
+    std::vector<ir::reduce_inst*> group;
+    for(auto it = insts.begin(); it != insts.end(); ++it){
+      auto *red = dynamic_cast<ir::reduce_inst*>(*it);
+      if(!red || std::find(group.begin(), group.end(), red) != group.end())
+        continue;
+      if(group.empty() || !layouts_->can_fuse(group.front(), red)){
+        group = {red};
+        continue;
+      }
+      // instructions that depend on the group, in order
+      std::set<ir::value*> deps(group.begin(), group.end());
+      std::vector<ir::instruction*> to_move;
+      bool ok = true;
+      for(auto jt = std::find(insts.begin(), it, group.front()); jt != it && ok; ++jt){
+        ir::instruction *i = *jt;
+        bool is_dep = deps.count(i) > 0;
+        for(ir::value *op: i->ops())
+          is_dep = is_dep || deps.count(op) > 0;
+        if(!is_dep)
+          continue;
+        ok = is_movable(i);
+        deps.insert(i);
+        to_move.push_back(i);
+      }
+      for(ir::value *op: red->ops())
+        ok = ok && deps.count(op) == 0;
+      if(!ok){
+        group = {red};
+        continue;
+      }
+      auto pos = std::next(it);
+      for(ir::instruction *i: to_move){
+        insts.remove(i);
+        insts.insert(pos, i);
+      }
+      group.insert(group.begin(), red);
+    }
+  }
 }
 
 }
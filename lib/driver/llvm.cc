@@ -23,7 +23,14 @@
 #if __has_include(<unistd.h>)
     #include <unistd.h>
 #endif
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <regex>
 #include "triton/driver/llvm.h"
 #include "triton/driver/dispatch.h"
@@ -70,14 +77,18 @@ namespace triton{
 namespace driver{
 
 void init_llvm() {
-  LLVMInitializeNVPTXTargetInfo();
-  LLVMInitializeNVPTXTarget();
-  LLVMInitializeNVPTXTargetMC();
-  LLVMInitializeNVPTXAsmPrinter();
-  LLVMInitializeAMDGPUTargetInfo();
-  LLVMInitializeAMDGPUTarget();
-  LLVMInitializeAMDGPUTargetMC();
-  LLVMInitializeAMDGPUAsmPrinter();
+  // modules may be compiled concurrently from background threads
+  static std::once_flag initialized;
+  std::call_once(initialized, [](){
+    LLVMInitializeNVPTXTargetInfo();
+    LLVMInitializeNVPTXTarget();
+    LLVMInitializeNVPTXTargetMC();
+    LLVMInitializeNVPTXAsmPrinter();
+    LLVMInitializeAMDGPUTargetInfo();
+    LLVMInitializeAMDGPUTarget();
+    LLVMInitializeAMDGPUTargetMC();
+    LLVMInitializeAMDGPUAsmPrinter();
+  });
 }
 
 
@@ -93,19 +104,71 @@ static bool find_and_replace(std::string& str, const std::string& begin, const s
   return true;
 }
 
+// Runs `args` (searched in PATH) with `in` and `out` as standard input and
+// output when they are >= 0. What the process writes to its standard error --
+// and to its standard output when `out` < 0 -- is appended to `log`. Returns
+// the exit status, or -1 if the process could not be run.
+static int spawn(const std::vector<std::string>& args, int in, int out, std::string& log) {
+  int fds[2];
+  if(pipe2(fds, O_CLOEXEC) != 0)
+    return -1;
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if(in >= 0)
+    posix_spawn_file_actions_adddup2(&actions, in, 0);
+  posix_spawn_file_actions_adddup2(&actions, out >= 0 ? out : fds[1], 1);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], 2);
+  std::vector<char*> argv;
+  for(const std::string& arg: args)
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(nullptr);
+  pid_t pid;
+  int err = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(fds[1]);
+  if(err != 0){
+    close(fds[0]);
+    return -1;
+  }
+  // drain the pipe before waiting, so that large logs do not block the child
+  char buf[4096];
+  ssize_t n;
+  while((n = read(fds[0], buf, sizeof(buf))) != 0){
+    if(n > 0)
+      log.append(buf, n);
+    else if(errno != EINTR)
+      break;
+  }
+  close(fds[0]);
+  int status;
+  while(waitpid(pid, &status, 0) < 0)
+    if(errno != EINTR)
+      return -1;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
 std::string path_to_ptxas(int& version) {
+  // ptxas is looked for once per process (and value of TRITON_PTXAS_PATH)
+  static std::mutex mutex;
+  static std::map<std::string, std::pair<std::string, int>> found;
+  std::string triton_ptxas = tools::getenv("TRITON_PTXAS_PATH");
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = found.find(triton_ptxas);
+  if(it != found.end()){
+    version = it->second.second;
+    return it->second.first;
+  }
   std::vector<std::string> rets;
-  std::string ret;
   // search pathes for ptxas
   std::vector<std::string> ptxas_prefixes = {"", "/usr/local/cuda/bin/"};
-  std::string triton_ptxas = tools::getenv("TRITON_PTXAS_PATH");
   if(!triton_ptxas.empty())
     ptxas_prefixes.insert(ptxas_prefixes.begin(), triton_ptxas);
   // see what path for ptxas are valid
   std::vector<std::string> working_ptxas;
   for(std::string prefix: ptxas_prefixes){
     std::string ptxas = prefix + "ptxas";
-    bool works = tools::exec(ptxas + " --version 2>&1", ret) == 0;
+    std::string ret;
+    bool works = spawn({ptxas, "--version"}, -1, -1, ret) == 0;
     if(works) {
       working_ptxas.push_back(ptxas);
       rets.push_back(ret);
@@ -119,20 +182,21 @@ std::string path_to_ptxas(int& version) {
   // parse version
   std::regex version_regex("release (\\d+)\\.(\\d+)");
   std::smatch match;
-  bool found = false;
+  bool found_version = false;
   // currently choosing the first ptxas. Other logics can be implemented in future
   for(std::string ret : rets) {
     if(std::regex_search(ret, match, version_regex)){
       int major = std::stoi(match[1]);
       int minor = std::stoi(match[2]);
       version = major*1000 + minor*10;
-      found = true;
+      found_version = true;
       break;
     }
   }
-  if ( not found) {
+  if ( not found_version) {
     throw std::runtime_error("Error in parsing version");
   }
+  found[triton_ptxas] = {ptxas, version};
   return ptxas;
 }
 
@@ -149,7 +213,17 @@ int vptx(int version){
   throw std::runtime_error("Triton requires CUDA 10+");
 }
 
-std::string llir_to_ptx(llvm::Module* module, int cc, int version){
+static llvm::CodeGenOpt::Level codegen_opt_level(int opt_level) {
+  switch(opt_level){
+    case 0: return llvm::CodeGenOpt::None;
+    case 1: return llvm::CodeGenOpt::Less;
+    case 2: return llvm::CodeGenOpt::Default;
+    case 3: return llvm::CodeGenOpt::Aggressive;
+    default: throw std::runtime_error("invalid optimization level: " + std::to_string(opt_level));
+  }
+}
+
+std::string llir_to_ptx(llvm::Module* module, int cc, int version, int opt_level){
   // LLVM version in use may not officially support target hardware
   int max_nvvm_cc = 75;
   int max_nvvm_ptx = 74;
@@ -190,7 +264,7 @@ std::string llir_to_ptx(llvm::Module* module, int cc, int version){
   opt.NoInfsFPMath = false;
   opt.NoNaNsFPMath = true;
   machine = target->createTargetMachine(module->getTargetTriple(), proc, features, opt,
-                                                             llvm::Reloc::PIC_, llvm::None, llvm::CodeGenOpt::Aggressive);
+                                                             llvm::Reloc::PIC_, llvm::None, codegen_opt_level(opt_level));
   // set data layout
   if(layout.empty())
     module->setDataLayout(machine->createDataLayout());
@@ -215,38 +289,52 @@ std::string llir_to_ptx(llvm::Module* module, int cc, int version){
 }
 
 
-std::string ptx_to_cubin(const std::string& ptx, const std::string& ptxas, int cc) {
-  // compile ptx with ptxas
-  char _fsrc[L_tmpnam];
-  char _flog[L_tmpnam];
-  std::tmpnam(_fsrc);
-  std::tmpnam(_flog);
-  std::string fsrc = _fsrc;
-  std::string flog = _flog;
-  std::string fbin = fsrc + ".o";
-  const char* _fbin = fbin.c_str();
-  std::ofstream ofs(fsrc);
-  ofs << ptx << std::endl;
-  ofs.close();
-  std::string cmd;
-  int err;
-  cmd = ptxas + " -v --gpu-name=sm_" + std::to_string(cc) + " " + fsrc + " -o " + fsrc + ".o 2> " + flog;
-  err = system(cmd.c_str());
+std::string ptx_to_cubin(const std::string& ptx, const std::string& ptxas, int cc, int opt_level) {
+  // ptxas reads and writes in-memory files, passed as its standard input
+  // and output, so that concurrent compilations never touch the disk
+  int src = memfd_create("ptx", MFD_CLOEXEC);
+  int bin = memfd_create("cubin", MFD_CLOEXEC);
+  if(src < 0 || bin < 0){
+    if(src >= 0) close(src);
+    if(bin >= 0) close(bin);
+    throw std::runtime_error("Internal Triton PTX codegen error: cannot create in-memory files");
+  }
+  std::string in = ptx + "\n";
+  for(size_t off = 0; off < in.size(); ){
+    ssize_t n = write(src, in.data() + off, in.size() - off);
+    if(n < 0 && errno == EINTR)
+      continue;
+    if(n < 0){
+      close(src);
+      close(bin);
+      throw std::runtime_error("Internal Triton PTX codegen error: cannot write PTX");
+    }
+    off += n;
+  }
+  lseek(src, 0, SEEK_SET);
+  std::string log;
+  std::vector<std::string> args = {ptxas, "-v", "--gpu-name=sm_" + std::to_string(cc)};
+  // ptxas defaults to -O3
+  if(opt_level != 3)
+    args.push_back("-O" + std::to_string(opt_level));
+  args.insert(args.end(), {"/dev/stdin", "-o", "/dev/stdout"});
+  int err = spawn(args, src, bin, log);
+  close(src);
   if(err != 0){
-    std::ifstream _log(_flog);
-    std::string log(std::istreambuf_iterator<char>(_log), {});
-    unlink(_fsrc);
-    unlink(_flog);
+    close(bin);
     throw std::runtime_error("Internal Triton PTX codegen error: \n" + log);
   }
-  CUmodule ret;
-  std::ifstream _cubin(_fbin, std::ios::binary );
-  std::string cubin(std::istreambuf_iterator<char>(_cubin), {});
-  _cubin.close();
-  unlink(_fsrc);
-  unlink(_flog);
-  unlink(_fbin);
-  dispatch::cuModuleLoadData(&ret, cubin.c_str());
+  std::string cubin;
+  char buf[1 << 16];
+  ssize_t n;
+  lseek(bin, 0, SEEK_SET);
+  while((n = read(bin, buf, sizeof(buf))) != 0){
+    if(n > 0)
+      cubin.append(buf, n);
+    else if(errno != EINTR)
+      break;
+  }
+  close(bin);
   return cubin;
 }
 
@@ -1,5 +1,7 @@
 #include <cassert>
 #include <stdexcept>
+#include <iomanip>
+#include <sstream>
 #include "triton/ir/constant.h"
 #include "triton/ir/type.h"
 #include "triton/ir/context.h"
@@ -62,6 +64,13 @@ constant_int *constant_int::get(type *ty, uint64_t value) {
 constant_fp::constant_fp(type *ty, double value)
   : constant(ty, 0), value_(value){ }
 
+// printed with enough digits to be read back exactly
+std::string constant_fp::repr() const {
+  std::ostringstream os;
+  os << std::setprecision(17) << value_;
+  return os.str();
+}
+
 constant *constant_fp::get_negative_zero(type *ty){
   double neg_zero = 0;
   return get(ty, neg_zero);
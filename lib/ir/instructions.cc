@@ -151,6 +151,14 @@ launch_inst* launch_inst::create(ir::function *fn, const std::vector<ir::value *
 //===----------------------------------------------------------------------===//
 
 std::string binary_operator::repr_impl() const {
+  std::string flags;
+  if(has_no_unsigned_wrap_) flags += ".nuw";
+  if(has_no_signed_wrap_)   flags += ".nsw";
+  if(op_ == FDiv && fdiv_ieee_rnd_) flags += ".ieee";
+  return repr_op() + flags;
+}
+
+std::string binary_operator::repr_op() const {
   switch(op_) {
   case Add  : return "add";
   case FAdd : return "fadd";
@@ -200,7 +208,8 @@ bool binary_operator::is_int_add_sub() const {
 
 
 binary_operator::binary_operator(binary_op_t op, value *lhs, value *rhs, type *ty, const std::string &name, instruction *next)
-    : instruction(ty, INST_BINOP, 2, name, next), op_(op), fdiv_ieee_rnd_(false){
+    : instruction(ty, INST_BINOP, 2, name, next), op_(op), has_no_unsigned_wrap_(false), has_no_signed_wrap_(false),
+      fdiv_ieee_rnd_(false){
   set_operand(0, lhs);
   set_operand(1, rhs);
 }
@@ -716,6 +725,11 @@ instruction *dot_inst::create_tt(value *A, value *B, value *C, bool allow_tf32,
   return new dot_inst(A, B, C, Trans, Trans, allow_tf32, name, next);
 }
 
+std::string dot_inst::repr_impl() const {
+  return std::string("dot") + (AT_ == Trans ? ".ta" : "") + (BT_ == Trans ? ".tb" : "")
+                            + (allow_tf32_ ? ".tf32" : "");
+}
+
 //===----------------------------------------------------------------------===//
 //                               trans instructions
 //===----------------------------------------------------------------------===//
@@ -760,6 +774,13 @@ const std::vector<int> trans_inst::get_perm() const {
   return perm_;
 }
 
+std::string trans_inst::repr_impl() const {
+  std::string ret = "trans(";
+  for(size_t i = 0; i < perm_.size(); i++)
+    ret += (i ? ", " : "") + std::to_string(perm_[i]);
+  return ret + ")";
+}
+
 //===----------------------------------------------------------------------===//
 //                               sqrt instructions
 //===----------------------------------------------------------------------===//
@@ -779,18 +800,29 @@ instruction* sqrt_inst::create(value *arg, const std::string &name, instruction
 
 std::string reduce_inst::to_str(op_t op) {
   switch (op) {
-    case ADD: return "+";
-    case SUB: return "-";
+    case ADD: return "add";
+    case SUB: return "sub";
     case MAX: return "imax";
     case MIN: return "imin";
-    case FADD: return "+";
-    case FSUB: return "-";
+    case UMAX: return "umax";
+    case UMIN: return "umin";
+    case ARGMAX: return "argimax";
+    case ARGMIN: return "argimin";
+    case ARGUMAX: return "argumax";
+    case ARGUMIN: return "argumin";
+    case FADD: return "fadd";
+    case FSUB: return "fsub";
     case FMAX: return "fmax";
     case FMIN: return "fmin";
-    default: break;
+    case ARGFMAX: return "argfmax";
+    case ARGFMIN: return "argfmin";
+    case XOR: return "xor";
+    default: throw std::runtime_error("unreachable");
   }
-  assert(false);
-  return "";
+}
+
+std::string reduce_inst::repr_impl() const {
+  return "reduce(" + to_str(op_) + ", " + std::to_string(axis_) + ")";
 }
 
 type* reduce_inst::get_res_type(value *arg, unsigned axis) {
@@ -867,6 +899,22 @@ instruction* atomic_rmw_inst::create(atomic_rmw_op_t op, value *ptr, value *val,
   return new atomic_rmw_inst(op, ptr, val, msk, name, next);
 }
 
+std::string atomic_rmw_inst::repr_impl() const {
+  switch(op_){
+  case atomic_rmw_op_t::And:  return "atomic_rmw.and";
+  case atomic_rmw_op_t::Or:   return "atomic_rmw.or";
+  case atomic_rmw_op_t::Xor:  return "atomic_rmw.xor";
+  case atomic_rmw_op_t::Add:  return "atomic_rmw.add";
+  case atomic_rmw_op_t::Max:  return "atomic_rmw.max";
+  case atomic_rmw_op_t::Min:  return "atomic_rmw.min";
+  case atomic_rmw_op_t::UMax: return "atomic_rmw.umax";
+  case atomic_rmw_op_t::UMin: return "atomic_rmw.umin";
+  case atomic_rmw_op_t::FAdd: return "atomic_rmw.fadd";
+  case atomic_rmw_op_t::Xchg: return "atomic_rmw.xchg";
+  default: throw std::runtime_error("unreachable");
+  }
+}
+
 
 // atomic cas
 
@@ -292,6 +292,14 @@ void AssemblyWriter::print_instruction(const instruction *instr) {
     write_operand(ops[i]);
   }
 
+  // Print metadata
+  for (const auto &md : instr->get_metadatas()) {
+    os << (md.first == ir::metadata::multiple_of ? " !multiple_of(" : " !max_contiguous(");
+    for (size_t i = 0; i < md.second.size(); ++i)
+      os << (i ? ", " : "") << md.second[i];
+    os << ")";
+  }
+
   os << ";\n";
 }
 
@@ -0,0 +1,242 @@
+import argparse
+import ast
+import importlib
+import json
+import os
+import statistics
+import sys
+import time
+
+import triton
+import triton._C.libtriton.triton as _triton
+import triton.language as tl
+
+# Compilation time of a corpus of representative kernels: the tutorials, the
+# kernels of `triton.ops` (matmul, cross_entropy, blocksparse), and an
+# elementwise kernel of growing tile sizes, whose `isel` time shows how
+# instruction selection scales with the number of values per thread. Kernels are
+# compiled from Python to PTX for an explicit compute capability, so no GPU is
+# needed. The time spent in the frontend (Python AST to Triton-IR), in each
+# pass of `add_passes_to_emit_bin`, in `link_extern_libs` and in `llir_to_ptx`
+# is written as JSON, and can be compared with a previous run:
+#
+#   python bench_compile.py -o base.json
+#   python bench_compile.py -o new.json --baseline base.json
+
+_TUTORIALS = os.path.join(os.path.dirname(os.path.realpath(__file__)), os.pardir, 'tutorials')
+
+
+def _is_jit(decorator):
+    if isinstance(decorator, ast.Call):
+        decorator = decorator.func
+    return isinstance(decorator, ast.Attribute) and decorator.attr == 'jit' and \
+        isinstance(decorator.value, ast.Name) and decorator.value.id == 'triton'
+
+
+def _load_tutorial(name):
+    # the tutorials run on the GPU when imported:
+    # only execute their imports of triton and their kernels
+    path = os.path.realpath(os.path.join(_TUTORIALS, name))
+    with open(path) as f:
+        tree = ast.parse(f.read(), path)
+    body = []
+    for node in tree.body:
+        if isinstance(node, ast.Import) and all(a.name.startswith('triton') for a in node.names):
+            body.append(node)
+        elif isinstance(node, ast.FunctionDef) and any(_is_jit(d) for d in node.decorator_list):
+            body.append(node)
+    scope = {'__name__': f'tutorials.{name}'}
+    # the original file name and line numbers let `inspect` find the source of kernels
+    exec(compile(ast.Module(body=body, type_ignores=[]), path, 'exec'), scope)
+    return scope
+
+
+@triton.jit
+def _elementwise(Y, X, stride, BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr):
+    rm = tl.arange(0, BLOCK_M)
+    rn = tl.arange(0, BLOCK_N)
+    offs = rm[:, None] * stride + rn[None, :]
+    x = tl.load(X + offs)
+    y = x * x + 1.
+    y = tl.where(y > 2., y - x, y * 0.5)
+    y = tl.exp(y) + tl.sqrt(x * x)
+    tl.store(Y + offs, y)
+
+
+class Case:
+    '''
+    A kernel specialized for a launch. `signature` lists the types of the
+    arguments that are not in `constants`, in order: `*dtype` for pointers
+    and scalar type names (e.g., `i32`, `f` for floats, `B` for booleans).
+    Pointers and integers are assumed to be multiples of 16.
+    '''
+
+    def __init__(self, name, fn, signature, constants, num_warps=4, num_stages=2):
+        self.name = name
+        self.fn = fn
+        self.num_warps = num_warps
+        self.num_stages = num_stages
+        types = [ty.strip() for ty in signature.split(',')]
+        names = [n for n in fn.arg_names if n not in constants]
+        assert len(types) == len(names), f'{name}: {len(names)} argument types expected'
+        types = dict(zip(names, types))
+        self.arg_types = []
+        self.attributes = dict()
+        self.constants = dict()
+        for i, arg in enumerate(fn.arg_names):
+            if arg in constants:
+                self.constants[i] = constants[arg]
+                continue
+            ty = types[arg]
+            if ty.startswith('*'):
+                self.arg_types.append(('ptr', ty[1:]))
+                self.attributes[i] = 16
+            else:
+                self.arg_types.append(('scalar', ty))
+                if ty[0] in 'iu':
+                    self.attributes[i] = 16
+
+    def compile(self, cc, version, opt_level):
+        '''
+        Returns the time spent in each stage, in ms
+        '''
+        context = _triton.ir.context()
+        start = time.perf_counter()
+        module = self.fn._generate_ttir(context, self.arg_types, self.attributes, self.constants)
+        timings = {'frontend': (time.perf_counter() - start) * 1e3}
+        _, _, _, passes = _triton.code_gen.ttir_to_ptx(module, cc, self.num_warps, self.num_stages,
+                                                       version=version, opt_level=opt_level)
+        timings.update(passes)
+        return timings
+
+
+def corpus():
+    cases = []
+    # tutorials
+    t = _load_tutorial('01-vector-add.py')
+    cases.append(Case('vector-add', t['add_kernel'], '*f32, *f32, *f32, i32', {'BLOCK_SIZE': 1024}))
+    t = _load_tutorial('02-fused-softmax.py')
+    cases.append(Case('fused-softmax', t['softmax_kernel'], '*f32, *f32, i32, i32, i32', {'BLOCK_SIZE': 1024}))
+    t = _load_tutorial('03-matrix-multiplication.py')
+    for act in ['', 'leaky_relu']:
+        cases.append(Case(f'matrix-multiplication{"-" + act if act else ""}', t['matmul_kernel'],
+                          '*f16, *f16, *f16, i32, i32, i32, i32, i32, i32',
+                          {'stride_ak': 1, 'stride_bn': 1, 'stride_cn': 1, 'BLOCK_SIZE_M': 128, 'BLOCK_SIZE_N': 256,
+                           'BLOCK_SIZE_K': 32, 'GROUP_SIZE_M': 8, 'ACTIVATION': act}, num_warps=8, num_stages=3))
+    t = _load_tutorial('04-low-memory-dropout.py')
+    cases.append(Case('seeded-dropout', t['_seeded_dropout'], '*f32, *f32, i32, f, i32', {'BLOCK_SIZE': 1024}))
+    t = _load_tutorial('05-layer-norm.py')
+    cases.append(Case('layer-norm-fwd', t['_layer_norm_fwd_fused'], '*f16, *f16, *f16, *f16, *f32, *f32, i32, i32, f',
+                      {'BLOCK_SIZE': 1024}, num_warps=4))
+    cases.append(Case('layer-norm-bwd-dx', t['_layer_norm_bwd_dx_fused'], '*f16, *f16, *f16, *f16, *f32, *f32, i32, i32, i32, f',
+                      {'BLOCK_SIZE_N': 1024}, num_warps=4))
+    cases.append(Case('layer-norm-bwd-dwdb', t['_layer_norm_bwd_dwdb'], '*f16, *f16, *f32, *f32, *f16, *f16, i32, i32',
+                      {'BLOCK_SIZE_M': 32, 'BLOCK_SIZE_N': 128}))
+    t = _load_tutorial('06-fused-attention.py')
+    strides = ', '.join(['i32'] * 3)
+    cases.append(Case('fused-attention-fwd', t['_fwd_kernel'],
+                      f'*f16, *f16, *f16, f, *f32, *f32, *f32, *f16, {strides}, {strides}, {strides}, {strides}, i32, i32, i32',
+                      {'stride_qk': 1, 'stride_kk': 1, 'stride_vn': 1, 'stride_on': 1,
+                       'BLOCK_M': 128, 'BLOCK_DMODEL': 64, 'BLOCK_N': 128}, num_warps=4, num_stages=1))
+    cases.append(Case('fused-attention-bwd', t['_bwd_kernel'],
+                      f'*f16, *f16, *f16, f, *f16, *f16, *f32, *f16, *f16, *f32, *f32, *f32, {strides}, {strides}, {strides}, i32, i32, i32, i32',
+                      {'stride_qk': 1, 'stride_kk': 1, 'stride_vn': 1,
+                       'BLOCK_M': 128, 'BLOCK_DMODEL': 64, 'BLOCK_N': 128}, num_warps=8, num_stages=1))
+    t = _load_tutorial('07-libdevice-function.py')
+    cases.append(Case('libdevice-asin', t['asin_kernel'], '*f32, *f32, i32', {'BLOCK_SIZE': 1024}))
+    # matmul
+    matmul = importlib.import_module('triton.ops.matmul')
+    for block_m, block_n, block_k, split_k, num_warps, num_stages in [(128, 256, 32, 1, 8, 3),
+                                                                       (128, 128, 32, 1, 4, 4),
+                                                                       (64, 32, 64, 1, 2, 5),
+                                                                       (32, 64, 32, 4, 2, 3)]:
+        cases.append(Case(f'matmul-{block_m}x{block_n}x{block_k}-split{split_k}', matmul._kernel,
+                          '*f16, *f16, *f16, i32, i32, i32, i32, i32, i32',
+                          {'stride_ak': 1, 'stride_bn': 1, 'stride_cn': 1, 'BLOCK_M': block_m, 'BLOCK_N': block_n,
+                           'BLOCK_K': block_k, 'GROUP_M': 8, 'SPLIT_K': split_k, 'EVEN_K': True, 'ACC_TYPE': tl.float32},
+                          num_warps=num_warps, num_stages=num_stages))
+    # cross_entropy
+    cross_entropy = importlib.import_module('triton.ops.cross_entropy')
+    cases.append(Case('cross-entropy-fwd', cross_entropy._forward, '*f32, *f32, *i64, *f32, i32', {'BLOCK': 4096}, num_warps=8))
+    cases.append(Case('cross-entropy-bwd', cross_entropy._backward, '*f32, *i64, *f32, i32', {'BLOCK': 4096}, num_warps=8))
+    # blocksparse
+    bs_matmul = importlib.import_module('triton.ops.blocksparse.matmul')
+    bs_softmax = importlib.import_module('triton.ops.blocksparse.softmax')
+    strides = ', '.join(['i32'] * 3)
+    cases.append(Case('blocksparse-sdd', bs_matmul._sdd_kernel, f'*f16, *f16, *f16, {strides}, {strides}, {strides}, i32, i32, *i32',
+                      {'stride_ak': 1, 'stride_nb': 1, 'stride_nc': 1, 'TILE_M': 32, 'TILE_N': 32, 'TILE_K': 32,
+                       'BLOCK': 32, 'EVEN_K': True}, num_stages=4))
+    cases.append(Case('blocksparse-dsd', bs_matmul._dsd_kernel, f'*f16, *f16, *f16, {strides}, {strides}, {strides}, i32, i32, *i32',
+                      {'stride_ak': 1, 'stride_bn': 1, 'stride_cn': 1, 'TILE_M': 32, 'TILE_N': 128, 'TILE_K': 32,
+                       'GROUP_SIZE_M': 4, 'BLOCK': 32}, num_stages=4))
+    cases.append(Case('blocksparse-softmax-fwd', bs_softmax._blocksparse_softmax_fwd, '*f16, *f16, i32, *i32, i32, i32, i32, f, B',
+                      {'R': None, 'ROW_SIZE': 256, 'BLOCK_SIZE': 32, 'IS_DENSE': False}))
+    # tile sizes
+    for block in [16, 32, 64, 128, 256]:
+        for num_warps in [4, 8]:
+            cases.append(Case(f'elementwise-{block}x{block}-{num_warps}w', _elementwise, '*f32, *f32, i32',
+                              {'BLOCK_M': block, 'BLOCK_N': block}, num_warps=num_warps))
+    return cases
+
+
+def run(cases, cc, version, opt_level, repeat):
+    '''
+    Returns the median time spent in each stage, in ms, by kernel
+    '''
+    results = dict()
+    for case in cases:
+        runs = [case.compile(cc, version, opt_level) for _ in range(repeat)]
+        timings = {stage: statistics.median(r[stage] for r in runs) for stage in runs[0]}
+        timings['total'] = statistics.median(sum(r.values()) for r in runs)
+        results[case.name] = timings
+    return results
+
+
+def compare(results, baseline, threshold):
+    '''
+    Prints the stages whose time changed by more than `threshold` relative
+    to `baseline`, and returns the number of regressions
+    '''
+    num_regressions = 0
+    for name, timings in results.items():
+        if name not in baseline:
+            print(f'{name}: not in baseline')
+            continue
+        for stage, ms in timings.items():
+            base = baseline[name].get(stage)
+            if not base:
+                continue
+            change = ms / base - 1
+            if abs(change) > threshold:
+                print(f'{name}: {stage}: {base:.2f} ms -> {ms:.2f} ms ({change:+.0%})')
+                num_regressions += change > 0
+    return num_regressions
+
+
+def main(args):
+    parser = argparse.ArgumentParser(description="Benchmark the compilation time of the kernel corpus.")
+    parser.add_argument("-o", "--output", type=str, default='compile.json')
+    parser.add_argument("-n", "--names", type=str, default='', help="only compile kernels whose name contains this string")
+    parser.add_argument("--cc", type=int, default=80, help="compute capability of the generated PTX")
+    parser.add_argument("--cuda-version", type=int, default=0,
+                        help="CUDA version (e.g., 11040) that determines the PTX version; defaults to the one of ptxas")
+    parser.add_argument("--opt-level", type=int, default=3)
+    parser.add_argument("-r", "--repeat", type=int, default=5)
+    parser.add_argument("--baseline", type=str, default=None, help="JSON file written by a previous run")
+    parser.add_argument("--threshold", type=float, default=0.1, help="relative change reported when comparing to a baseline")
+    args = parser.parse_args(args)
+    cases = [c for c in corpus() if args.names in c.name]
+    results = run(cases, args.cc, args.cuda_version, args.opt_level, args.repeat)
+    with open(args.output, 'w') as f:
+        json.dump({'cc': args.cc, 'opt_level': args.opt_level, 'repeat': args.repeat, 'kernels': results}, f, indent=1)
+    for name, timings in results.items():
+        print(f'{name}: {timings["total"]:.2f} ms')
+    if args.baseline is not None:
+        with open(args.baseline) as f:
+            baseline = json.load(f)['kernels']
+        return 1 if compare(results, baseline, args.threshold) else 0
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
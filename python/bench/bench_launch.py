@@ -0,0 +1,172 @@
+import contextlib
+import time
+
+import torch
+
+import triton
+import triton._C.libtriton.triton as _triton
+import triton.language as tl
+
+# Host-side cost of `Kernel.__call__`: argument parsing, cache lookup, grid
+# evaluation and parameter packing. Kernels are never compiled nor enqueued,
+# so that these benchmarks run without a GPU.
+
+
+class _Tensor:
+    def __init__(self, addr, dtype=torch.float32):
+        self.addr = addr
+        self.dtype = dtype
+
+    def data_ptr(self):
+        return self.addr
+
+
+class _Binary:
+    kernel = 0
+    shared_mem = 0
+
+
+@contextlib.contextmanager
+def _noop_launcher():
+    code_gen = triton.code_gen
+    patched = [(torch.cuda, 'current_device', lambda: 0),
+               (torch.cuda, 'set_device', lambda device: None),
+               (torch.cuda, 'get_device_capability', lambda device: (8, 0)),
+               (code_gen, 'current_cuda_stream', lambda device: 0)]
+    saved = [(obj, name, getattr(obj, name)) for obj, name, _ in patched]
+
+    def add_to_cache(self, key, wargs, device_idx, num_warps, num_stages, extern_libs):
+        self.fn.bin_cache[key] = _Binary()
+        return False
+    saved += [(code_gen.Kernel, 'add_to_cache', code_gen.Kernel.add_to_cache)]
+    patched += [(code_gen.Kernel, 'add_to_cache', add_to_cache)]
+    for obj, name, value in patched:
+        setattr(obj, name, value)
+    _triton.runtime.set_noop_launcher(True)
+    try:
+        yield
+    finally:
+        _triton.runtime.set_noop_launcher(False)
+        for obj, name, value in saved:
+            setattr(obj, name, value)
+
+
+def _time_launches(launch, n_launches, n_repeat=5):
+    """Returns the mean, min and max time per launch in nanoseconds."""
+    with _noop_launcher():
+        launch(0)
+        times = []
+        for _ in range(n_repeat):
+            start = time.perf_counter_ns()
+            for i in range(n_launches):
+                launch(i)
+            times += [(time.perf_counter_ns() - start) / n_launches]
+        assert _triton.runtime.num_noop_launches() == n_launches * n_repeat + 1
+    return sum(times) / n_repeat, min(times), max(times)
+
+
+@triton.jit
+def _kernel_1(A0):
+    pass
+
+
+@triton.jit
+def _kernel_4(A0, A1, A2, A3):
+    pass
+
+
+@triton.jit
+def _kernel_16(A0, A1, A2, A3, A4, A5, A6, A7,
+               A8, A9, A10, A11, A12, A13, A14, A15):
+    pass
+
+
+_kernels = {1: _kernel_1, 4: _kernel_4, 16: _kernel_16}
+
+
+def _make_args(num_args, mix):
+    if mix == 'tensors':
+        return [_Tensor(256 * (i + 1)) for i in range(num_args)]
+    if mix == 'ints':
+        return [1024 + i for i in range(num_args)]
+    # alternate tensors, ints, floats and constexprs
+    makers = [lambda i: _Tensor(256 * (i + 1)),
+              lambda i: 1024 + i,
+              lambda i: 0.5,
+              lambda i: tl.constexpr(128)]
+    return [makers[i % len(makers)](i) for i in range(num_args)]
+
+
+confs = [
+    triton.testing.Benchmark(
+        x_names=['num_args'],
+        x_vals=[1, 4, 16],
+        line_arg='mix',
+        line_vals=['tensors', 'ints', 'mixed'],
+        line_names=['Tensors', 'Integers', 'Mixed'],
+        ylabel='ns / launch',
+        plot_name='launch-overhead-arguments',
+        args={'n_launches': 10000},
+    )
+]
+
+
+@triton.testing.perf_report(confs)
+def bench_arguments(num_args, mix, n_launches):
+    kernel = _kernels[num_args]
+    args = _make_args(num_args, mix)
+    return _time_launches(lambda i: kernel[(1, )](*args), n_launches)
+
+
+confs = [
+    triton.testing.Benchmark(
+        x_names=['num_specializations'],
+        x_vals=[1, 2, 4, 8],
+        line_arg='provider',
+        line_vals=['launch-cache', 'dict'],
+        line_names=['Hashed signature', 'String key + dict'],
+        ylabel='ns / launch',
+        plot_name='launch-overhead-specializations',
+        args={'n_launches': 10000},
+    )
+]
+
+
+@triton.testing.perf_report(confs)
+def bench_specializations(num_specializations, provider, n_launches):
+    # every launch hits the cache, but consecutive launches
+    # cycle through `num_specializations` different kernels
+    blocks = [tl.constexpr(16 << i) for i in range(num_specializations)]
+    x = _Tensor(256)
+    launch_cache = _kernel_4.launch_cache
+    if provider == 'dict':
+        _kernel_4.launch_cache = None
+    try:
+        return _time_launches(lambda i: _kernel_4[(1, )](x, x, 1024, blocks[i % num_specializations]), n_launches)
+    finally:
+        _kernel_4.launch_cache = launch_cache
+
+
+confs = [
+    triton.testing.Benchmark(
+        x_names=['num_args'],
+        x_vals=[4, 16],
+        line_arg='grid',
+        line_vals=['tuple', 'lambda'],
+        line_names=['Tuple', 'Lambda'],
+        ylabel='ns / launch',
+        plot_name='launch-overhead-grid',
+        args={'n_launches': 10000},
+    )
+]
+
+
+@triton.testing.perf_report(confs)
+def bench_grid(num_args, grid, n_launches):
+    kernel = _kernels[num_args]
+    args = _make_args(num_args, 'mixed')
+    if grid == 'tuple':
+        grid = (4, )
+    else:
+        grid = lambda META: (triton.cdiv(512, META['A3']), )
+    return _time_launches(lambda i: kernel[grid](*args), n_launches)
@@ -0,0 +1,80 @@
+import os
+import tempfile
+import time
+
+import torch
+
+import triton
+import triton.language as tl
+
+# Compilation time and running time of kernels compiled at each
+# `opt_level`. Kernels are compiled from scratch every time.
+
+
+@triton.jit
+def _add(X, Y, Z, N, BLOCK: tl.constexpr):
+    offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+    mask = offs < N
+    x = tl.load(X + offs, mask=mask)
+    y = tl.load(Y + offs, mask=mask)
+    tl.store(Z + offs, x + y, mask=mask)
+
+
+@triton.jit
+def _softmax(Y, X, stride, N, BLOCK: tl.constexpr):
+    row = tl.program_id(0)
+    offs = tl.arange(0, BLOCK)
+    x = tl.load(X + row * stride + offs, mask=offs < N, other=-float('inf'))
+    x = x - tl.max(x, axis=0)
+    num = tl.exp(x)
+    tl.store(Y + row * stride + offs, num / tl.sum(num, axis=0), mask=offs < N)
+
+
+def _launcher(kernel, size):
+    if kernel == 'add':
+        x = torch.randn(size, device='cuda')
+        y = torch.randn(size, device='cuda')
+        z = torch.empty_like(x)
+        return _add, lambda **kw: _add[(triton.cdiv(size, 1024), )](x, y, z, size, BLOCK=1024, **kw)
+    x = torch.randn((4096, size), device='cuda')
+    y = torch.empty_like(x)
+    block = triton.next_power_of_2(size)
+    return _softmax, lambda **kw: _softmax[(x.shape[0], )](y, x, x.stride(0), size, BLOCK=block, num_warps=8, **kw)
+
+
+def _compile_time(fn, launch, opt_level):
+    with tempfile.TemporaryDirectory() as cache_dir:
+        os.environ['TRITON_CACHE_DIR'] = cache_dir
+        try:
+            fn.bin_cache.clear()
+            fn.launch_cache.clear()
+            torch.cuda.synchronize()
+            start = time.perf_counter()
+            launch(opt_level=opt_level)
+            torch.cuda.synchronize()
+            return (time.perf_counter() - start) * 1e3
+        finally:
+            del os.environ['TRITON_CACHE_DIR']
+
+
+confs = [
+    triton.testing.Benchmark(
+        x_names=['opt_level'],
+        x_vals=[0, 1, 2, 3],
+        line_arg='metric',
+        line_vals=['compile', 'run'],
+        line_names=['Compilation', 'Execution'],
+        ylabel='ms',
+        plot_name=f'opt-level-{kernel}',
+        args={'kernel': kernel, 'size': size},
+    ) for kernel, size in [('add', 1 << 24), ('softmax', 1024)]
+]
+
+
+@triton.testing.perf_report(confs)
+def bench_opt_level(opt_level, metric, kernel, size):
+    fn, launch = _launcher(kernel, size)
+    if metric == 'compile':
+        times = [_compile_time(fn, launch, opt_level) for _ in range(3)]
+        return sum(times) / len(times), min(times), max(times)
+    return triton.testing.do_bench(lambda: launch(opt_level=opt_level))
@@ -8,6 +8,10 @@
 #include "triton/ir/function.h"
 #include "triton/ir/module.h"
 #include "triton/ir/print.h"
+#include "triton/tools/sha1.hpp"
+#include "triton/tools/thread_pool.h"
+#include <chrono>
+#include <memory>
 #include <optional>
 #include <pybind11/buffer_info.h>
 #include <pybind11/functional.h>
@@ -19,8 +23,13 @@
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/SourceMgr.h"
 
 namespace py = pybind11;
 namespace ir = triton::ir;
@@ -129,8 +138,16 @@ std::string dtype_cache_key_part(const py::object& dtype) {
   }
 }
 
+// Stand-in for the driver: launches are counted instead of enqueued, so
+// that the host-side cost of launching kernels can be measured without a GPU
+struct noop_launcher_t {
+  bool enabled = false;
+  uint64_t num_launches = 0;
+};
+static noop_launcher_t noop_launcher;
+
 size_t get_pointer_range_size(uint64_t addr){
-  if(addr == 0)
+  if(addr == 0 || noop_launcher.enabled)
     return 0;
   size_t size;
   drv::dispatch::cuPointerGetAttribute(&size, CU_POINTER_ATTRIBUTE_RANGE_SIZE, (CUdeviceptr)addr);
@@ -229,9 +246,10 @@ void parse_args(py::list& args, py::list do_not_specialize, const std::string& f
         // udpate cache key
         cache_key += dtype_cache_key_part(arg.attr("dtype"));
         cache_key += "*";
+        if(!specialize)
+          continue;
         cache_key += "[multipleof(";
-        size_t range_size = get_pointer_range_size(value);
-        cache_key += std::to_string(std::min(pow2_divisor(value), pow2_divisor(range_size)));
+        cache_key += std::to_string(pow2_divisor(value));
         cache_key += ")]";
         continue;
       }
@@ -269,7 +287,406 @@ void parse_args(py::list& args, py::list do_not_specialize, const std::string& f
   }
 }
 
-//
+// ---------------------------------------
+// Launch fast path
+// ---------------------------------------
+
+// Everything `parse_args` puts in the cache key, without building the
+// string: specialization words, and objects that are compared by value
+// (dtypes, reprs of constexpr values, extern libs)
+struct launch_signature {
+  PyObject* func_key = nullptr;
+  uint64_t words[4*64 + 2];
+  size_t n_words = 0;
+  PyObject* objects[2*64 + 32];
+  size_t n_objects = 0;
+  uint64_t hash = 0;
+
+  launch_signature() { }
+  launch_signature(const launch_signature&) = delete;
+  ~launch_signature() {
+    for(size_t i = 0; i < n_objects; i++)
+      Py_DECREF(objects[i]);
+  }
+
+  void push_word(uint64_t w) { words[n_words++] = w; }
+  // steals a reference to `o`
+  bool push_object(PyObject* o) {
+    if(n_objects == sizeof(objects)/sizeof(objects[0])){
+      Py_DECREF(o);
+      return false;
+    }
+    objects[n_objects++] = o;
+    return true;
+  }
+};
+
+// Loaded kernels of a JITFunction indexed by the hash of their
+// `launch_signature`. Open addressing with linear probing, so that lookups
+// never allocate. Hits are checked against the full signature. The cache
+// is emptied when it holds `max_size` kernels: launches then go through
+// `bin_cache` until it is filled again
+class launch_cache {
+public:
+  struct entry {
+    uint64_t key;
+    PyObject* bin;
+    uint64_t kernel;
+    uint64_t shared_mem;
+    PyObject* func_key;
+    std::vector<uint64_t> words;
+    std::vector<PyObject*> objects;
+  };
+
+  launch_cache(): entries_(16), size_(0) { }
+  ~launch_cache() { clear(); }
+
+  const entry* find(const launch_signature& sig) const {
+    size_t mask = entries_.size() - 1;
+    for(size_t i = sig.hash & mask; entries_[i].bin; i = (i + 1) & mask)
+      if(entries_[i].key == sig.hash && matches(entries_[i], sig))
+        return &entries_[i];
+    return nullptr;
+  }
+
+  static constexpr size_t max_size = 1024;
+
+  void insert(const launch_signature& sig, py::object bin) {
+    if(find(sig))
+      return;
+    if(size_ == max_size)
+      clear();
+    if(2*(size_ + 1) > entries_.size())
+      rehash(2*entries_.size());
+    entry e = {sig.hash, bin.ptr(), py::cast<uint64_t>(bin.attr("kernel")), py::cast<uint64_t>(bin.attr("shared_mem")),
+               sig.func_key, std::vector<uint64_t>(sig.words, sig.words + sig.n_words),
+               std::vector<PyObject*>(sig.objects, sig.objects + sig.n_objects)};
+    Py_INCREF(e.bin);
+    Py_INCREF(e.func_key);
+    for(PyObject* o: e.objects)
+      Py_INCREF(o);
+    place(entries_, std::move(e));
+    size_++;
+  }
+
+  void clear() {
+    for(entry& e: entries_){
+      Py_XDECREF(e.bin);
+      Py_XDECREF(e.func_key);
+      for(PyObject* o: e.objects)
+        Py_DECREF(o);
+      e = entry();
+    }
+    size_ = 0;
+  }
+
+  size_t size() const { return size_; }
+
+private:
+  static bool matches(const entry& e, const launch_signature& sig) {
+    if(e.words.size() != sig.n_words || e.objects.size() != sig.n_objects)
+      return false;
+    if(std::memcmp(e.words.data(), sig.words, sig.n_words*sizeof(uint64_t)) != 0)
+      return false;
+    if(e.func_key != sig.func_key && PyUnicode_Compare(e.func_key, sig.func_key) != 0){
+      PyErr_Clear();
+      return false;
+    }
+    for(size_t i = 0; i < sig.n_objects; i++){
+      PyObject* a = e.objects[i];
+      PyObject* b = sig.objects[i];
+      if(a == b)
+        continue;
+      // e.g., 1 and True are equal but do not specialize the same way
+      if(Py_TYPE(a) != Py_TYPE(b))
+        return false;
+      int eq = PyObject_RichCompareBool(a, b, Py_EQ);
+      if(eq != 1){
+        PyErr_Clear();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static void place(std::vector<entry>& entries, entry&& e) {
+    size_t mask = entries.size() - 1;
+    size_t i = e.key & mask;
+    while(entries[i].bin)
+      i = (i + 1) & mask;
+    entries[i] = std::move(e);
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<entry> entries(capacity);
+    for(entry& e: entries_)
+      if(e.bin)
+        place(entries, std::move(e));
+    entries_.swap(entries);
+  }
+
+  std::vector<entry> entries_;
+  size_t size_;
+};
+
+static inline void hash_combine(uint64_t& seed, uint64_t v) {
+  seed ^= v + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+// 64-bit FNV-1a
+static inline uint64_t hash_bytes(const char* data, size_t size) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for(size_t i = 0; i < size; i++){
+    h ^= (unsigned char)data[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+// Same as `parse_args`, but collects the specialization key in `sig`
+// instead of building it as a string. Returns false when some argument
+// needs the slow path (which also produces the proper error messages)
+static bool hash_args(PyObject* args, uint64_t do_not_specialize_mask, PyObject* func_key,
+                      long num_warps, long num_stages, PyObject* extern_libs,
+                      launch_signature& sig, char* params, size_t& params_size) {
+  static PyObject* data_ptr_str = PyUnicode_InternFromString("data_ptr");
+  static PyObject* dtype_str = PyUnicode_InternFromString("dtype");
+  static PyObject* value_str = PyUnicode_InternFromString("value");
+  sig.func_key = func_key;
+  sig.push_word((uint64_t)num_warps);
+  sig.push_word((uint64_t)num_stages);
+  char* params_ptr = params;
+  size_t len = PyList_GET_SIZE(args);
+  for(size_t i = 0; i < len; i++){
+    bool specialize = !((do_not_specialize_mask >> i) & 1);
+    PyObject* arg = PyList_GET_ITEM(args, i);
+    // argument is `long`
+    if(PyLong_Check(arg)){
+      int overflow;
+      long long value = PyLong_AsLongLongAndOverflow(arg, &overflow);
+      if(overflow)
+        return false;
+      if(specialize && (value == 1)){
+        sig.push_word(1);
+        continue;
+      }
+      if(-0x8000'0000LL <= value && value <= 0x7FFF'FFFFLL){
+        sig.push_word(2);
+        params_ptr = (char*)(((uintptr_t)params_ptr + 3) & (-4));
+        std::memcpy(params_ptr, &value, 4);
+        params_ptr += 4;
+      } else if(0x8000'0000LL <= value && value <= 0xFFFF'FFFFLL){
+        sig.push_word(3);
+        params_ptr = (char*)(((uintptr_t)params_ptr + 3) & (-4));
+        std::memcpy(params_ptr, &value, 4);
+        params_ptr += 4;
+      } else {
+        sig.push_word(4);
+        params_ptr = (char*)(((uintptr_t)params_ptr + 7) & (-8));
+        std::memcpy(params_ptr, &value, 8);
+        params_ptr += 8;
+      }
+      if(specialize)
+        sig.push_word(pow2_divisor(value));
+      continue;
+    }
+    // argument is `float`
+    if(PyFloat_Check(arg)){
+      sig.push_word(5);
+      float value = PyFloat_AsDouble(arg);
+      params_ptr = (char*)(((uintptr_t)params_ptr + 3) & (-4));
+      std::memcpy(params_ptr, &value, 4);
+      params_ptr += 4;
+      continue;
+    }
+    // argument is tensor
+    if(PyObject* data_ptr = PyObject_CallMethodObjArgs(arg, data_ptr_str, NULL)){
+      long value = PyLong_AsLong(data_ptr);
+      Py_DECREF(data_ptr);
+      PyObject* dtype = PyObject_GetAttr(arg, dtype_str);
+      if(!dtype){
+        PyErr_Clear();
+        return false;
+      }
+      if(!sig.push_object(dtype))
+        return false;
+      params_ptr = (char*)(((uintptr_t)params_ptr + 7) & (-8));
+      std::memcpy(params_ptr, &value, 8);
+      params_ptr += 8;
+      sig.push_word(6);
+      if(specialize)
+        sig.push_word(pow2_divisor(value));
+      continue;
+    }
+    PyErr_Clear();
+    // argument is `constexpr`: keyed by its repr, like in `parse_args`
+    // (e.g., -0.0 and 0.0 are equal but have different kernels)
+    if(PyObject* value = PyObject_GetAttr(arg, value_str)){
+      sig.push_word(7);
+      bool callable = PyCallable_Check(value);
+      PyObject* repr = callable ? nullptr : PyObject_Repr(value);
+      Py_DECREF(value);
+      if(!repr){
+        PyErr_Clear();
+        return false;
+      }
+      if(!sig.push_object(repr))
+        return false;
+      continue;
+    }
+    PyErr_Clear();
+    if(arg == Py_None){
+      sig.push_word(8);
+      continue;
+    }
+    return false;
+  }
+  params_size = (std::ptrdiff_t)(params_ptr - params);
+  PyObject *lib_name, *lib_path;
+  Py_ssize_t pos = 0;
+  while(PyDict_Next(extern_libs, &pos, &lib_name, &lib_path)){
+    Py_INCREF(lib_name);
+    if(!sig.push_object(lib_name))
+      return false;
+    Py_INCREF(lib_path);
+    if(!sig.push_object(lib_path))
+      return false;
+  }
+  // hash
+  Py_ssize_t func_key_size;
+  const char* func_key_data = PyUnicode_AsUTF8AndSize(func_key, &func_key_size);
+  if(!func_key_data){
+    PyErr_Clear();
+    return false;
+  }
+  sig.hash = hash_bytes(func_key_data, func_key_size);
+  for(size_t i = 0; i < sig.n_words; i++)
+    hash_combine(sig.hash, sig.words[i]);
+  for(size_t i = 0; i < sig.n_objects; i++){
+    Py_hash_t h = PyObject_Hash(sig.objects[i]);
+    if(h == -1){
+      PyErr_Clear();
+      return false;
+    }
+    hash_combine(sig.hash, h);
+  }
+  return true;
+}
+
+// grid may be a callable of the compile-time constants
+static bool get_grid(py::object& grid, py::dict& constants, int& grid_0, int& grid_1, int& grid_2) {
+  py::sequence seq;
+  if(!PySequence_Check(grid.ptr()))
+    seq = grid(constants);
+  else
+    seq = grid;
+  int size = seq.size();
+  grid_0 = py::cast<int>(seq[0]);
+  grid_1 = size < 2 ? 1 : py::cast<int>(seq[1]);
+  grid_2 = size < 3 ? 1 : py::cast<int>(seq[2]);
+  return grid_0*grid_1*grid_2 > 0;
+}
+
+static void cu_launch(uint64_t kernel, int grid_0, int grid_1, int grid_2, long num_warps,
+                      uint64_t shared_mem, uint64_t stream, void* params, size_t params_size) {
+  if(noop_launcher.enabled){
+    noop_launcher.num_launches++;
+    return;
+  }
+  void *config[] = {
+      CU_LAUNCH_PARAM_BUFFER_POINTER, params,
+      CU_LAUNCH_PARAM_BUFFER_SIZE, &params_size,
+      CU_LAUNCH_PARAM_END
+  };
+  // release the gil in case the enqueue blocks
+  // cuda will block if too many ops are enqueued
+  py::gil_scoped_release allow_threads;
+  drv::dispatch::cuLaunchKernel((CUfunction)kernel, grid_0, grid_1, grid_2,
+                                num_warps*32, 1, 1, shared_mem, (CUstream)stream,
+                                nullptr, config);
+}
+
+// ---------------------------------------
+// Background compilation
+// ---------------------------------------
+
+namespace {
+
+// Result of a python callable submitted to a `compile_pool`
+class compile_future {
+public:
+  bool done() const {
+    return done_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+
+  // waits without holding the GIL and re-raises
+  // the exception of the callable, if any
+  py::object result() {
+    {
+      py::gil_scoped_release allow_threads;
+      done_.wait();
+    }
+    if(error_type_){
+      PyErr_Restore(error_type_.inc_ref().ptr(), error_value_.inc_ref().ptr(),
+                    error_trace_.inc_ref().ptr());
+      throw py::error_already_set();
+    }
+    return result_;
+  }
+
+private:
+  friend class compile_pool;
+  py::object fn_;
+  py::object result_;
+  py::object error_type_;
+  py::object error_value_;
+  py::object error_trace_;
+  std::shared_future<void> done_;
+};
+
+// Workers hold the GIL while running python code (e.g., the code
+// generator) and release it in `compile_ttir`, where compilation
+// spends most of its time
+class compile_pool {
+public:
+  compile_pool(size_t num_workers): pool_(new ThreadPool(num_workers)) { }
+  ~compile_pool() { shutdown(); }
+
+  std::shared_ptr<compile_future> submit(py::function fn) {
+    if(!pool_)
+      throw std::runtime_error("submit on shut down compile_pool");
+    auto future = std::make_shared<compile_future>();
+    future->fn_ = fn;
+    // the worker cannot acquire the GIL before `done_` is set
+    future->done_ = pool_->enqueue([future]() mutable {
+      py::gil_scoped_acquire gil;
+      try {
+        future->result_ = future->fn_();
+      } catch(py::error_already_set& e) {
+        future->error_type_ = e.type();
+        future->error_value_ = e.value();
+        future->error_trace_ = e.trace();
+      }
+      future->fn_ = py::object();
+      // python objects may only be released with the GIL held
+      future.reset();
+    }).share();
+    return future;
+  }
+
+  // waits for pending tasks
+  void shutdown() {
+    if(!pool_)
+      return;
+    py::gil_scoped_release allow_threads;
+    pool_.reset();
+  }
+
+private:
+  std::unique_ptr<ThreadPool> pool_;
+};
+
+} // namespace
 
 void init_triton_runtime(py::module &&m) {
 
@@ -296,18 +713,78 @@ void init_triton_runtime(py::module &&m) {
   m.def("get_pointer_range_size", &get_pointer_range_size);
 
 
+  // replace the driver by a launcher that only counts launches
+  m.def("set_noop_launcher", [](bool enabled) {
+    noop_launcher.enabled = enabled;
+    noop_launcher.num_launches = 0;
+  });
+  m.def("num_noop_launches", []() { return noop_launcher.num_launches; });
+
+  py::class_<compile_future, std::shared_ptr<compile_future>>(m, "compile_future")
+      .def("done", &compile_future::done)
+      .def("result", &compile_future::result);
+
+  py::class_<compile_pool>(m, "compile_pool")
+      .def(py::init<size_t>(), py::arg("num_workers"))
+      .def("submit", &compile_pool::submit)
+      .def("shutdown", &compile_pool::shutdown);
+
+  py::class_<launch_cache>(m, "launch_cache")
+      .def(py::init<>())
+      .def("clear", &launch_cache::clear)
+      .def("__len__", &launch_cache::size);
+
   // cache key
-  m.def("launch", [](py::list args, py::list do_not_specialize, const std::string& func_key, py::list& arg_names, 
-                     py::object device, py::int_ stream, py::dict bin_cache, py::int_ num_warps, py::int_ num_stages, 
-                     py::dict extern_libs, py::function add_to_cache, py::object grid){
-    // parse arguments to compute cache key, compile-time constants and packed kernel arguments
+  m.def("launch", [](py::list args, py::list do_not_specialize, py::str func_key, py::list& arg_names,
+                     py::object device, py::int_ stream, py::dict bin_cache, py::int_ num_warps, py::int_ num_stages,
+                     py::dict extern_libs, py::function add_to_cache, py::object grid, py::object fast_cache){
     long _num_warps = PyLong_AsLong(num_warps.ptr());
     long _num_stages = PyLong_AsLong(num_stages.ptr());
+    uint64_t _stream = PyLong_AsLong(stream.ptr());
+    int grid_0, grid_1, grid_2;
+    // fast path: hash arguments and look up loaded kernels without
+    // building the string key or touching `bin_cache`
+    launch_cache* cache = fast_cache.is_none() ? nullptr : fast_cache.cast<launch_cache*>();
+    uint64_t do_not_specialize_mask = 0;
+    size_t len = PyList_GET_SIZE(args.ptr());
+    bool fast = cache && len <= 64;
+    for(Py_ssize_t k = 0; fast && k < PyList_GET_SIZE(do_not_specialize.ptr()); k++){
+      long idx = PyLong_AsLong(PyList_GET_ITEM(do_not_specialize.ptr(), k));
+      if(idx < 0 || idx >= 64)
+        fast = false;
+      else
+        do_not_specialize_mask |= 1ULL << idx;
+    }
+    launch_signature sig;
+    alignas(8) char fast_params[16*64];
+    size_t fast_params_size;
+    if(fast && hash_args(args.ptr(), do_not_specialize_mask, func_key.ptr(), _num_warps, _num_stages,
+                         extern_libs.ptr(), sig, fast_params, fast_params_size)){
+      if(const launch_cache::entry* e = cache->find(sig)){
+        py::object bin = py::reinterpret_borrow<py::object>(e->bin);
+        py::dict constants;
+        if(!PySequence_Check(grid.ptr()))
+          for(size_t i = 0; i < len; i++){
+            py::object arg = args[i];
+            if(!PyLong_Check(arg.ptr()) && !PyFloat_Check(arg.ptr()) && arg.ptr() != Py_None &&
+               !py::hasattr(arg, "data_ptr") && py::hasattr(arg, "value"))
+              constants[arg_names[i]] = arg.attr("value");
+          }
+        if(get_grid(grid, constants, grid_0, grid_1, grid_2))
+          cu_launch(e->kernel, grid_0, grid_1, grid_2, _num_warps, e->shared_mem, _stream,
+                    fast_params, fast_params_size);
+        return bin;
+      }
+    }
+    else
+      fast = false;
+
+    // parse arguments to compute cache key, compile-time constants and packed kernel arguments
     std::string cache_key;
     std::string params;
     size_t params_size;
     py::dict constants;
-    parse_args(args, do_not_specialize, func_key, arg_names, cache_key, params,
+    parse_args(args, do_not_specialize, func_key.cast<std::string>(), arg_names, cache_key, params,
                params_size, constants, _num_warps, _num_stages, extern_libs);
 
     // get cached binary
@@ -319,39 +796,19 @@ void init_triton_runtime(py::module &&m) {
     if (noop)
       return (py::object)py::none();
     py::object bin = bin_cache[key];
-
-    // get grid
-    py::sequence seq;
-    if(!PySequence_Check(grid.ptr()))
-      seq = grid(constants);
-    else
-      seq = grid;
-    int size = seq.size();
-    int grid_0 = py::cast<int>(seq[0]);
-    int grid_1 = size < 2 ? 1 : py::cast<int>(seq[1]);
-    int grid_2 = size < 3 ? 1 : py::cast<int>(seq[2]);
+    if(fast)
+      cache->insert(sig, bin);
 
     // enqueue
     uint64_t kernel = py::cast<uint64_t>(bin.attr("kernel"));
     uint64_t shared_mem = py::cast<uint64_t>(bin.attr("shared_mem"));
-
-    // actually launch
-    void *config[] = {
-        CU_LAUNCH_PARAM_BUFFER_POINTER, params.data(),
-        CU_LAUNCH_PARAM_BUFFER_SIZE, &params_size,
-        CU_LAUNCH_PARAM_END
-    };
-    uint64_t _stream = PyLong_AsLong(stream.ptr());
-    if(grid_0*grid_1*grid_2 > 0) {
-      // release the gil in case the enqueue blocks
-      // cuda will block if too many ops are enqueued
-      py::gil_scoped_release allow_threads;
-      drv::dispatch::cuLaunchKernel((CUfunction)kernel, grid_0, grid_1, grid_2, 
-                                    _num_warps*32, 1, 1, shared_mem, (CUstream)_stream, 
-                                     nullptr, config);
-   }
+    if(get_grid(grid, constants, grid_0, grid_1, grid_2))
+      cu_launch(kernel, grid_0, grid_1, grid_2, _num_warps, shared_mem, _stream,
+                params.data(), params_size);
     return bin;
-  });
+  }, py::arg("args"), py::arg("do_not_specialize"), py::arg("func_key"), py::arg("arg_names"),
+     py::arg("device"), py::arg("stream"), py::arg("bin_cache"), py::arg("num_warps"), py::arg("num_stages"),
+     py::arg("extern_libs"), py::arg("add_to_cache"), py::arg("grid"), py::arg("fast_cache") = py::none());
 
   m.def("cc", [](backend_t backend, uint64_t device) -> int {
     if (backend == CUDA) {
@@ -437,6 +894,7 @@ std::tuple<uint64_t, uint64_t, uint64_t, uint64_t> cu_load_binary(const std::str
     assembly = py::cast<std::string>(asm_map["cubin"]);
   else
     assembly = py::cast<std::string>(asm_map["ptx"]);
+  py::gil_scoped_release allow_threads;
   // create driver handles
   CUfunction fun;
   CUmodule mod;
@@ -465,6 +923,7 @@ std::tuple<uint64_t, uint64_t, uint64_t, uint64_t> cu_load_binary(const std::str
 std::tuple<uint64_t, uint64_t, uint64_t, uint64_t> hip_load_binary(const std::string& name, asm_map_t &asm_map, size_t n_shared_bytes, uint64_t dev){
   py::bytes _assembly = asm_map["hsaco"];
   std::string assembly = py::cast<std::string>(_assembly);
+  py::gil_scoped_release allow_threads;
   // HSA-CO -> hipModule
   hipModule_t mod = drv::amdgpu_to_hipmodule(assembly);
   // Handle to the kernel
@@ -474,15 +933,122 @@ std::tuple<uint64_t, uint64_t, uint64_t, uint64_t> hip_load_binary(const std::st
   return std::make_tuple((uint64_t)mod, (uint64_t)fun, 0, 0);
 }
 
+// ---------------------------------------
+// Stage-level compilation cache
+// ---------------------------------------
+
+// Intermediate results of `compile_ttir`, addressed by the hash of their
+// input and of the options of the stage that produced them. Backed by
+// a python object with `get(key) -> bytes or None` and `put(key, bytes)`,
+// or disabled when it is None. Can be used while the GIL is released
+namespace {
+
+// Hashes what is written to it, so that the key of a
+// module can be computed without printing it to memory
+class sha1_streambuf: public std::streambuf {
+public:
+  sha1_streambuf() { setp(buf_, buf_ + sizeof(buf_)); }
+
+  std::string hex() {
+    sync();
+    return llvm::toHex(sha1_.final(), /*LowerCase=*/true);
+  }
+
+protected:
+  int_type overflow(int_type c) override {
+    sync();
+    if(!traits_type::eq_int_type(c, traits_type::eof())){
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  int sync() override {
+    sha1_.update(llvm::StringRef(pbase(), pptr() - pbase()));
+    setp(buf_, buf_ + sizeof(buf_));
+    return 0;
+  }
+
+private:
+  char buf_[1 << 16];
+  llvm::SHA1 sha1_;
+};
+
+class stage_cache {
+public:
+  stage_cache(py::handle store): store_(store) { }
+
+  static std::string key(const std::string& stage, const std::string& options,
+                         const std::string& input) {
+    std::string content = options + "\n" + input;
+    unsigned char hash[20];
+    char hex[41];
+    sha1::calc(content.data(), content.size(), hash);
+    sha1::toHexString(hash, hex);
+    return stage + "-" + hex;
+  }
+
+  // same as above, with the text of `input` as input
+  static std::string key(const std::string& stage, const std::string& options,
+                         ir::module& input) {
+    sha1_streambuf buf;
+    std::ostream os(&buf);
+    os << options << "\n";
+    input.print(os);
+    os.flush();
+    return stage + "-" + buf.hex();
+  }
+
+  bool enabled() const { return !store_.is_none(); }
+
+  bool get(const std::string& key, std::string& value) const {
+    if(store_.is_none())
+      return false;
+    py::gil_scoped_acquire gil;
+    py::object ret = store_.attr("get")(key);
+    if(ret.is_none())
+      return false;
+    value = ret.cast<std::string>();
+    return true;
+  }
+
+  void put(const std::string& key, const std::string& value) const {
+    if(store_.is_none())
+      return;
+    py::gil_scoped_acquire gil;
+    store_.attr("put")(key, py::bytes(value));
+  }
+
+private:
+  py::handle store_;
+};
+
+} // namespace
+
 // --------------------------------------- 
 // Compile Triton-IR to assembly
 // --------------------------------------- 
 
 // CUDA
-std::tuple<std::string, asm_map_t, int> cu_compile_ttir(
-    const std::string &name, ir::module &ir, uint64_t device, int num_warps,
-    int num_stages, asm_map_t &asm_map,
-    const triton::codegen::ExternLibMap &extern_lib_map) {
+// The text of the Triton-IR and LLVM-IR is only recorded in `asm_map`
+// when `keep_ir` is set. Otherwise, the LLVM-IR is serialized as bitcode,
+// and only for the stage cache
+std::tuple<std::string, asm_map_t, int, int> cu_compile_ttir(
+    const std::string &name, ir::module &ir, uint64_t device,
+    int num_warps, int num_stages, asm_map_t &asm_map,
+    const triton::codegen::ExternLibMap &extern_lib_map, int max_regs,
+    const stage_cache &cache, int opt_level, bool keep_ir) {
+  int n_shared_bytes;
+  int n_regs_estimate;
+  std::string ttir;
+  std::string llir;
+  std::string tmp;
+  std::string ptx;
+  std::string cubin;
+  // python objects must not be touched while the GIL is released:
+  // other threads may be compiling concurrently
+  {
   py::gil_scoped_release allow_threads;
   llvm::LLVMContext ctx;
   // device properties
@@ -492,83 +1058,200 @@ std::tuple<std::string, asm_map_t, int> cu_compile_ttir(
   size_t cc = major*10 + minor;
   int version;
   std::string ptxas_path = drv::path_to_ptxas(version);
+  std::string target_options = std::to_string(cc) + "-" + std::to_string(version) + "-O" + std::to_string(opt_level);
+  std::string options = target_options + "-" + std::to_string(num_warps) + "-" + std::to_string(num_stages);
+  for(const auto& lib: extern_lib_map)
+    options += "-" + lib.first + ":" + lib.second->path();
+  if(keep_ir){
+    std::ostringstream os;
+    ir.print(os);
+    ttir = os.str();
+  }
   // Triton-IR -> NVPTX LLVM-IR
-  triton::codegen::nvidia_cu_target target(cc);
-  int n_shared_bytes;
-  auto llvm = triton::codegen::add_passes_to_emit_bin(
-      ir, ctx, &target, num_warps, num_stages, n_shared_bytes, extern_lib_map);
-  std::string tmp;
-  llvm::raw_string_ostream llir(tmp);
-  llir << *llvm;
-  llir.flush();
-  asm_map["llir"] = py::cast(tmp);
-  // LLVM-IR -> PTX
-  std::string ptx = drv::llir_to_ptx(llvm.get(), cc, version);
-  asm_map["ptx"] = py::cast(ptx);
-  // PTX -> Binary
-  std::string cubin = drv::ptx_to_cubin(ptx, ptxas_path, cc);
+  std::unique_ptr<llvm::Module> llvm;
+  auto parse = [&](){
+    llvm::SMDiagnostic err;
+    llvm = llvm::parseIR(llvm::MemoryBufferRef(llir, name), err, ctx);
+    if(!llvm)
+      throw std::runtime_error("invalid cached LLVM-IR: " + err.getMessage().str());
+  };
+  std::string llir_key;
+  if(cache.enabled())
+    llir_key = keep_ir ? stage_cache::key("llir", options, ttir) : stage_cache::key("llir", options, ir);
+  std::string cached;
+  if(cache.get(llir_key, cached)){
+    std::istringstream header(cached);
+    header >> n_shared_bytes >> n_regs_estimate;
+    llir = cached.substr(cached.find('\n') + 1);
+  }
+  else{
+    triton::codegen::nvidia_cu_target target(cc);
+    // bound to spill: stops before isel, and nothing is cached
+    llvm = triton::codegen::add_passes_to_emit_bin(
+        ir, ctx, &target, num_warps, num_stages, n_shared_bytes, n_regs_estimate, extern_lib_map,
+        opt_level, nullptr, max_regs);
+    if(llvm && cache.enabled()){
+      llvm::raw_string_ostream os(llir);
+      llvm::WriteBitcodeToFile(*llvm, os);
+      os.flush();
+      cache.put(llir_key, std::to_string(n_shared_bytes) + " " + std::to_string(n_regs_estimate) + "\n" + llir);
+    }
+  }
+  bool spills = max_regs > 0 && n_regs_estimate > max_regs;
+  if(keep_ir && !spills){
+    if(!llvm)
+      parse();
+    llvm::raw_string_ostream os(tmp);
+    os << *llvm;
+    os.flush();
+  }
+  // bound to spill: don't pay for PTX and SASS generation
+  if(!spills){
+    // LLVM-IR -> PTX
+    std::string ptx_key;
+    if(cache.enabled())
+      ptx_key = stage_cache::key("ptx", target_options, llir);
+    if(!cache.get(ptx_key, ptx)){
+      if(!llvm)
+        parse();
+      ptx = drv::llir_to_ptx(llvm.get(), cc, version, opt_level);
+      cache.put(ptx_key, ptx);
+    }
+    // PTX -> Binary
+    std::string cubin_key = stage_cache::key("cubin", target_options, ptx);
+    if(!cache.get(cubin_key, cubin)){
+      cubin = drv::ptx_to_cubin(ptx, ptxas_path, cc, opt_level);
+      cache.put(cubin_key, cubin);
+    }
+  }
+  }
+  if(keep_ir){
+    asm_map["ttir"] = py::cast(ttir);
+    if(!tmp.empty())
+      asm_map["llir"] = py::cast(tmp);
+  }
+  if(!ptx.empty())
+    asm_map["ptx"] = py::cast(ptx);
   if(!cubin.empty()){
     py::bytes bytes(cubin);
     asm_map["cubin"] = bytes;
   }
-  return std::make_tuple(name, asm_map, n_shared_bytes);
+  return std::make_tuple(name, asm_map, n_shared_bytes, n_regs_estimate);
 }
 
 // HIP
-std::tuple<std::string, asm_map_t, int> hip_compile_ttir(
+std::tuple<std::string, asm_map_t, int, int> hip_compile_ttir(
     const std::string &name, ir::module &ir, uint64_t device, int num_warps,
     int num_stages, asm_map_t &asm_map,
-    const triton::codegen::ExternLibMap &extern_lib_map) {
+    const triton::codegen::ExternLibMap &extern_lib_map, bool keep_ir) {
   llvm::LLVMContext ctx;
   // Triton-IR -> NVPTX LLVM-IR
   triton::codegen::amd_cl_target target;
   int n_shared_bytes;
+  int n_regs_estimate;
   auto llvm = triton::codegen::add_passes_to_emit_bin(
-      ir, ctx, &target, num_warps, num_stages, n_shared_bytes, extern_lib_map);
-  std::string tmp;
-  llvm::raw_string_ostream llir(tmp);
-  llir << *llvm;
-  llir.flush();
-  asm_map["llir"] = py::cast(tmp);
+      ir, ctx, &target, num_warps, num_stages, n_shared_bytes, n_regs_estimate, extern_lib_map);
+  if(keep_ir){
+    std::ostringstream ttir;
+    ir.print(ttir);
+    asm_map["ttir"] = py::cast(ttir.str());
+    std::string tmp;
+    llvm::raw_string_ostream llir(tmp);
+    llir << *llvm;
+    llir.flush();
+    asm_map["llir"] = py::cast(tmp);
+  }
   // LLVM-IR -> HSA-CO
   std::string path = drv::llir_to_amdgpu(llvm.get(), "gfx908");
   asm_map["hsaco"] = py::cast(path);
-  return std::make_tuple(name, asm_map, n_shared_bytes);
+  return std::make_tuple(name, asm_map, n_shared_bytes, n_regs_estimate);
+}
+
+static triton::codegen::ExternLibMap to_extern_lib_map(py::dict& extern_libs) {
+  triton::codegen::ExternLibMap extern_lib_map;
+  for (auto item : extern_libs) {
+    auto name = item.first.cast<std::string>();
+    auto path = item.second.cast<std::string>();
+    extern_lib_map.emplace(
+        name, triton::codegen::create_extern_lib(name, path));
+  }
+  return extern_lib_map;
 }
 
 void init_triton_codegen(py::module &&m) {
   m.def(
       "compile_ttir",
       [](backend_t backend, ir::module &ir, uint64_t device, int num_warps,
-         int num_stages, py::dict& extern_libs) {
+         int num_stages, py::dict& extern_libs, int max_regs, py::object stage_cache_store,
+         int opt_level, bool keep_ir) {
+        if(opt_level < 0 || opt_level > 3)
+          throw std::invalid_argument("invalid optimization level: " + std::to_string(opt_level));
         std::string name = ir.get_function_list()[0]->get_name();
         // record asm as we generate
         asm_map_t asm_map;
-        std::ostringstream ttir;
-        ir.print(ttir);
-        asm_map["ttir"] = py::cast(ttir.str());
-        llvm::LLVMContext ctx;
         // construct extern lib map
-        triton::codegen::ExternLibMap extern_lib_map;
-        for (auto item : extern_libs) {
-          auto name = item.first.cast<std::string>();
-          auto path = item.second.cast<std::string>();
-          extern_lib_map.emplace(
-              name, triton::codegen::create_extern_lib(name, path));
-        }
+        triton::codegen::ExternLibMap extern_lib_map = to_extern_lib_map(extern_libs);
         if(backend == CUDA)
-          return cu_compile_ttir(name, ir, device, num_warps, num_stages, asm_map, extern_lib_map);
+          return cu_compile_ttir(name, ir, device, num_warps, num_stages, asm_map, extern_lib_map,
+                                 max_regs, stage_cache(stage_cache_store), opt_level, keep_ir);
         assert(backend == ROCM);
-        return hip_compile_ttir(name, ir, device, num_warps, num_stages, asm_map, extern_lib_map);
+        return hip_compile_ttir(name, ir, device, num_warps, num_stages, asm_map, extern_lib_map, keep_ir);
       },
-      py::return_value_policy::take_ownership);
+      py::arg("backend"), py::arg("module"), py::arg("device"), py::arg("num_warps"),
+      py::arg("num_stages"), py::arg("extern_libs"), py::arg("max_regs") = 0,
+      py::arg("stage_cache") = py::none(), py::arg("opt_level") = 3,
+      py::arg("keep_ir") = true, py::return_value_policy::take_ownership);
+  // Triton-IR -> PTX for compute capability `cc`, without a GPU. `version` is
+  // the CUDA version that determines the PTX version, or <= 0 to use the one
+  // of ptxas. Returns the PTX, shared memory size and register estimate,
+  // and the time spent in each pass and in `llir_to_ptx`, in ms. The PTX is
+  // empty when more than `max_regs` (if > 0) registers are estimated live
+  m.def("ttir_to_ptx",
+      [](ir::module &ir, int cc, int num_warps, int num_stages, py::dict& extern_libs,
+         int version, int opt_level, int max_regs) {
+        if(opt_level < 0 || opt_level > 3)
+          throw std::invalid_argument("invalid optimization level: " + std::to_string(opt_level));
+        triton::codegen::ExternLibMap extern_lib_map = to_extern_lib_map(extern_libs);
+        triton::codegen::pass_timings timings;
+        int n_shared_bytes;
+        int n_regs_estimate;
+        std::string ptx;
+        {
+          py::gil_scoped_release allow_threads;
+          if(version <= 0)
+            drv::path_to_ptxas(version);
+          llvm::LLVMContext ctx;
+          triton::codegen::nvidia_cu_target target(cc);
+          auto llvm = triton::codegen::add_passes_to_emit_bin(
+              ir, ctx, &target, num_warps, num_stages, n_shared_bytes, n_regs_estimate,
+              extern_lib_map, opt_level, &timings, max_regs);
+          if(llvm){
+            auto start = std::chrono::steady_clock::now();
+            ptx = drv::llir_to_ptx(llvm.get(), cc, version, opt_level);
+            std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+            timings.emplace_back("llir_to_ptx", ms.count());
+          }
+        }
+        return std::make_tuple(ptx, n_shared_bytes, n_regs_estimate, timings);
+      },
+      py::arg("module"), py::arg("cc"), py::arg("num_warps") = 4, py::arg("num_stages") = 2,
+      py::arg("extern_libs") = py::dict(), py::arg("version") = 0, py::arg("opt_level") = 3,
+      py::arg("max_regs") = 0);
   m.def("load_binary", [](backend_t backend, const std::string& name, asm_map_t &asm_map, size_t n_shared_bytes, uint64_t dev){
-	py::gil_scoped_release allow_threads;
         if(backend == CUDA)
           return cu_load_binary(name, asm_map, n_shared_bytes, dev);
         assert(backend == ROCM);
         return hip_load_binary(name, asm_map, n_shared_bytes, dev);
       }, py::return_value_policy::take_ownership);
+  m.def("ptx_to_cubin", [](const std::string& ptx, int cc, int opt_level){
+        std::string cubin;
+        {
+          py::gil_scoped_release allow_threads;
+          int version;
+          cubin = drv::ptx_to_cubin(ptx, drv::path_to_ptxas(version), cc, opt_level);
+        }
+        return py::bytes(cubin);
+      }, py::arg("ptx"), py::arg("cc"), py::arg("opt_level") = 3);
 }
 
 
@@ -162,3 +162,75 @@ def test_elementwise(N):
     cur_gpu_perf = 3. * N * z.element_size() / ms * 1e-6
     cur_gpu_util = cur_gpu_perf / max_gpu_perf
     triton.testing.assert_almost_equal(cur_gpu_util, ref_gpu_util, decimal=2)
+
+
+#######################
+# Shared Memory
+#######################
+
+
+@triton.jit
+def _matmul(A, B, C, M, N, K,
+            stride_am, stride_ak, stride_bk, stride_bn, stride_cm, stride_cn,
+            BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, BLOCK_K: tl.constexpr):
+    pid_m = tl.program_id(0)
+    pid_n = tl.program_id(1)
+    rm = pid_m * BLOCK_M + tl.arange(0, BLOCK_M)
+    rn = pid_n * BLOCK_N + tl.arange(0, BLOCK_N)
+    rk = tl.arange(0, BLOCK_K)
+    A = A + (rm[:, None] * stride_am + rk[None, :] * stride_ak)
+    B = B + (rk[:, None] * stride_bk + rn[None, :] * stride_bn)
+    acc = tl.zeros((BLOCK_M, BLOCK_N), dtype=tl.float32)
+    for k in range(0, K, BLOCK_K):
+        acc += tl.dot(tl.load(A), tl.load(B))
+        A += BLOCK_K * stride_ak
+        B += BLOCK_K * stride_bk
+    C = C + (rm[:, None] * stride_cm + rn[None, :] * stride_cn)
+    tl.store(C, acc.to(tl.float16))
+
+
+@triton.jit
+def _softmax(Y, X, stride_xm, stride_ym, N, BLOCK: tl.constexpr):
+    row = tl.program_id(0)
+    cols = tl.arange(0, BLOCK)
+    x = tl.load(X + row * stride_xm + cols, mask=cols < N, other=-float('inf'))
+    z = x - tl.max(x, axis=0)
+    num = tl.exp(z)
+    y = num / tl.sum(num, axis=0)
+    tl.store(Y + row * stride_ym + cols, y, mask=cols < N)
+
+
+def _shared_memory_stats(capfd):
+    ret = []
+    for line in capfd.readouterr().err.splitlines():
+        if not line.startswith('allocation: '):
+            continue
+        _, name, stats = line.split(': ')
+        stats = stats.split(', ')
+        ret.append((name, int(stats[0].split()[0]), int(stats[1].split()[0]), int(stats[2].split()[0])))
+    return ret
+
+
+@pytest.mark.parametrize('kernel', ['matmul', 'softmax'])
+def test_shared_memory(kernel, capfd, tmp_path, monkeypatch):
+    # the allocator should pack buffers within alignment of the liveness lower bound
+    monkeypatch.setenv('TRITON_CODEGEN_STATS', '1')
+    monkeypatch.setenv('TRITON_CACHE_DIR', str(tmp_path))
+    torch.manual_seed(0)
+    if kernel == 'matmul':
+        a = torch.randn((512, 512), dtype=torch.float16, device='cuda')
+        b = torch.randn((512, 512), dtype=torch.float16, device='cuda')
+        c = torch.empty((512, 512), dtype=torch.float16, device='cuda')
+        for num_stages in [2, 3, 4]:
+            _matmul[(4, 4)](a, b, c, 512, 512, 512,
+                            a.stride(0), a.stride(1), b.stride(0), b.stride(1), c.stride(0), c.stride(1),
+                            BLOCK_M=128, BLOCK_N=128, BLOCK_K=32, num_stages=num_stages)
+    if kernel == 'softmax':
+        x = torch.randn((128, 781), dtype=torch.float32, device='cuda')
+        y = torch.empty_like(x)
+        _softmax[(x.shape[0], )](y, x, x.stride(0), y.stride(0), x.shape[1], BLOCK=1024)
+    stats = _shared_memory_stats(capfd)
+    assert stats
+    for name, allocated, peak_live, num_buffers in stats:
+        print(f'{name}: {allocated} bytes allocated, {peak_live} bytes peak live')
+        assert peak_live <= allocated <= peak_live + 16 * num_buffers
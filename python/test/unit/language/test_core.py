@@ -1,6 +1,9 @@
 # flake8: noqa: F821,F841
 import itertools
+import math
+import os
 import re
+import shutil
 from typing import Optional, Union
 
 import numpy as np
@@ -924,6 +927,27 @@ def test_reduce2d(op, dtype_str, shape, axis, device='cuda'):
         else:
             np.testing.assert_equal(z_ref, z_tri)
 
+
+@pytest.mark.parametrize("op, dtype_str, num_warps",
+                         [(op, dtype_str, num_warps)
+                          for op in ['argmin', 'argmax']
+                          for dtype_str in ['float16', 'float32', 'int32']
+                          for num_warps in [1, 4]])
+def test_reduce_ties(op, dtype_str, num_warps, device='cuda'):
+    # the smallest index is returned
+    @triton.jit
+    def kernel(X, Z, BLOCK: tl.constexpr):
+        x = tl.load(X + tl.arange(0, BLOCK))
+        tl.store(Z, GENERATE_TEST_HERE)
+
+    kernel = patch_kernel(kernel, {'GENERATE_TEST_HERE': f'tl.{op}(x, axis=0)'})
+    x = np.zeros(1024, dtype=getattr(np, dtype_str))
+    x[[100, 300, 700]] = 1 if op == 'argmax' else -1
+    x_tri = to_triton(x, device=device)
+    z_tri = to_triton(np.zeros(1, dtype=np.int32), device=device)
+    kernel[(1,)](x_tri, z_tri, BLOCK=1024, num_warps=num_warps)
+    assert to_numpy(z_tri)[0] == 100
+
 # ---------------
 # test permute
 # ---------------
@@ -1240,6 +1264,56 @@ def test_vectorization(N):
 # test for
 # ---------------
 
+
+@triton.jit
+def _pipelined_load(X, Y, Z, N, BLOCK: tl.constexpr, STORE: tl.constexpr):
+    offs = tl.arange(0, BLOCK)
+    acc = tl.zeros((BLOCK,), dtype=tl.float32)
+    ptrs = X + offs
+    for i in range(0, N, BLOCK):
+        x = tl.load(ptrs, mask=i + offs < N, other=0.)
+        acc += x
+        if STORE:
+            tl.store(Y + i + offs, 2 * x)
+        ptrs += BLOCK
+    tl.store(Z, tl.sum(acc, axis=0))
+
+
+@pytest.mark.parametrize("num_stages, store", [
+    (num_stages, store)
+    for num_stages in [1, 2, 3, 4]
+    for store in [False, True]
+])
+def test_for_pipelined_load(num_stages, store, device='cuda'):
+    # loads that do not feed a `dot` are prefetched into registers
+    N, BLOCK = 4096, 256
+    x = torch.randn(N, device=device)
+    y = torch.zeros(N, device=device)
+    z = torch.empty(1, device=device)
+    _pipelined_load[(1,)](x, y, z, N, BLOCK=BLOCK, STORE=store, num_stages=num_stages)
+    triton.testing.assert_almost_equal(y, 2 * x if store else torch.zeros_like(x))
+    triton.testing.assert_almost_equal(z, x.sum(dim=0, keepdim=True))
+
+
+@pytest.mark.parametrize("store", [False, True])
+def test_for_pipelined_load_ptx(store):
+    # no GPU: `num_stages - 1` loads are issued before the loop, unless
+    # the loop stores, in which case only one is
+    def num_loads(num_stages):
+        context = _triton.ir.context()
+        arg_types = [('ptr', 'f32'), ('ptr', 'f32'), ('ptr', 'f32'), ('scalar', 'i32')]
+        module = _pipelined_load._generate_ttir(context, arg_types, {0: 16, 1: 16, 2: 16, 3: 16},
+                                                {4: 256, 5: store})
+        ptx, _, _, _ = _triton.code_gen.ttir_to_ptx(module, 80, num_warps=4, num_stages=num_stages, version=11040)
+        return len(re.findall(r'ld\.global', ptx))
+    # global loads of a single iteration
+    n = num_loads(1)
+    assert n > 0
+    for num_stages in [2, 3, 4]:
+        expected = 2 if store else num_stages
+        assert num_loads(num_stages) == expected * n
+
+
 # ---------------
 # test while
 # ---------------
@@ -1460,3 +1534,57 @@ def test_libdevice(dtype_str, expr, lib_path):
         np.testing.assert_equal(y_ref, to_numpy(y_tri))
     else:
         np.testing.assert_allclose(y_ref, to_numpy(y_tri), rtol=0.01)
+
+
+@triton.jit
+def _lgamma(X, Y, BLOCK: tl.constexpr):
+    x = tl.load(X + tl.arange(0, BLOCK))
+    y = tl.libdevice.lgamma(x)
+    tl.store(Y + tl.arange(0, BLOCK), y)
+
+
+@pytest.mark.parametrize("block, outlined", [(1024, True), (32, False)])
+def test_libdevice_outlined(block, outlined):
+    # no GPU: large libdevice functions called once per element are kept
+    # out-of-line, and inlined when each thread calls them once
+    libdevice = os.path.join(os.path.dirname(triton.__file__), 'language', 'libdevice.10.bc')
+    context = _triton.ir.context()
+    module = _lgamma._generate_ttir(context, [('ptr', 'f32'), ('ptr', 'f32')], {0: 16, 1: 16}, {2: block})
+    ptx, _, _, _ = _triton.code_gen.ttir_to_ptx(module, 80, num_warps=1, extern_libs={'libdevice': libdevice},
+                                                version=11040)
+    calls = re.findall(r'call\.uni[^;]*?(__nv_\w+)', ptx)
+    if outlined:
+        assert '__nv_lgammaf' in calls
+        assert re.search(r'\.func\s+(\([^)]*\)\s*)?__nv_lgammaf\b', ptx)
+    else:
+        assert '__nv_lgammaf' not in calls
+
+
+def test_libdevice_lgamma():
+    shape = (1024, )
+    rs = RandomState(17)
+    x = np.abs(numpy_random(shape, dtype_str='float32', rs=rs)) + 0.5
+    y_ref = np.vectorize(math.lgamma)(x).astype(np.float32)
+    x_tri = to_triton(x)
+    y_tri = to_triton(np.empty_like(x), device='cuda')
+    _lgamma[(1,)](x_tri, y_tri, BLOCK=shape[0], num_warps=1)
+    np.testing.assert_allclose(y_ref, to_numpy(y_tri), rtol=0.01)
+
+
+def test_libdevice_cached(tmp_path, monkeypatch, capfd):
+    # no GPU: the file is read by the first compilation only
+    @triton.jit
+    def kernel(X, Y, BLOCK: tl.constexpr):
+        x = tl.load(X + tl.arange(0, BLOCK))
+        tl.store(Y + tl.arange(0, BLOCK), tl.libdevice.pow(x, x))
+
+    # a path no other test has loaded
+    path = str(tmp_path / 'libdevice.10.bc')
+    shutil.copy(os.path.join(os.path.dirname(triton.__file__), 'language', 'libdevice.10.bc'), path)
+    monkeypatch.setenv('TRITON_CODEGEN_STATS', '1')
+    for _ in range(2):
+        context = _triton.ir.context()
+        module = kernel._generate_ttir(context, [('ptr', 'f32'), ('ptr', 'f32')], {0: 16, 1: 16}, {2: 128})
+        _triton.code_gen.ttir_to_ptx(module, 80, num_warps=4, extern_libs={'libdevice': path}, version=11040)
+    stats = [line for line in capfd.readouterr().err.splitlines() if line.startswith('extern_lib: ')]
+    assert stats == [f'extern_lib: {path}: read', f'extern_lib: {path}: cached']
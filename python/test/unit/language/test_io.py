@@ -0,0 +1,146 @@
+import pytest
+import torch
+
+import triton
+import triton._C.libtriton.triton as _triton
+import triton.language as tl
+
+# Global memory accesses are compiled to PTX for sm_80 without being run,
+# so that these tests need no GPU (except `test_copy_2d` and `test_dot_store`). Vector widths
+# are read from the PTX or from the report printed with
+# `TRITON_CODEGEN_STATS`.
+
+
+@triton.jit
+def _copy(X, Y, N, OFFSET: tl.constexpr, BLOCK: tl.constexpr):
+    offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+    mask = offs < N
+    x = tl.load(X + OFFSET + offs, mask=mask)
+    tl.store(Y + offs, x, mask=mask)
+
+
+def _compile(dtype, offset, capfd, monkeypatch):
+    monkeypatch.setenv('TRITON_CODEGEN_STATS', '1')
+    arg_types = [('ptr', dtype), ('ptr', dtype), ('scalar', 'i32')]
+    # pointers and `N` are multiples of 16
+    attributes = {0: 16, 1: 16, 2: 16}
+    constants = {3: offset, 4: 2048}
+    context = _triton.ir.context()
+    module = _copy._generate_ttir(context, arg_types, attributes, constants)
+    ptx, _, _, _ = _triton.code_gen.ttir_to_ptx(module, 80, num_warps=4, version=11040)
+    # io: <kernel>: <load|store>: <n> access(es) of <bits> bits
+    widths = dict()
+    for line in capfd.readouterr().err.splitlines():
+        if line.startswith('io: '):
+            _, _, kind, stats = line.split(': ')
+            widths[kind] = int(stats.split(' of ')[1].split()[0])
+    return ptx, widths
+
+
+bits = {'i8': 8, 'f8': 8, 'f16': 16, 'bf16': 16, 'f32': 32, 'i64': 64, 'f64': 64}
+
+
+@pytest.mark.parametrize("dtype", list(bits))
+def test_vector_width(dtype, capfd, monkeypatch):
+    # accesses are 128 bits wide whatever the size of elements
+    ptx, widths = _compile(dtype, 0, capfd, monkeypatch)
+    assert widths == {'load': 128, 'store': 128}
+    vec = 'v2.b64' if bits[dtype] == 64 else 'v4.b32'
+    assert f'ld.global.{vec}' in ptx
+    assert f'st.global.{vec}' in ptx
+
+
+@pytest.mark.parametrize("dtype, offset", [
+    (dtype, offset)
+    for dtype in ['i8', 'f16', 'f32']
+    for offset in [1, 2, 4]
+])
+def test_vector_width_misaligned(dtype, offset, capfd, monkeypatch):
+    # the width of loads is limited by the alignment of their pointers
+    _, widths = _compile(dtype, offset, capfd, monkeypatch)
+    assert widths == {'load': offset * bits[dtype], 'store': 128}
+
+
+@triton.jit
+def _copy_2d(X, Y, stride_xm, stride_xn, stride_ym, stride_yn,
+             BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr):
+    rm = tl.arange(0, BLOCK_M)
+    rn = tl.arange(0, BLOCK_N)
+    x = tl.load(X + rm[:, None] * stride_xm + rn[None, :] * stride_xn)
+    tl.store(Y + rm[:, None] * stride_ym + rn[None, :] * stride_yn, x)
+
+
+@pytest.mark.parametrize("dtype", ['f16', 'f32'])
+def test_vector_width_2d(dtype):
+    # column-major blocks are contiguous along their first dimension
+    M, N = 64, 64
+    arg_types = [('ptr', dtype), ('ptr', dtype), ('scalar', 'i32'), ('scalar', 'i32')]
+    # strides along the first dimension are 1
+    constants = {2: 1, 4: 1, 6: M, 7: N}
+    attributes = {0: 16, 1: 16, 3: 16, 5: 16}
+    context = _triton.ir.context()
+    module = _copy_2d._generate_ttir(context, arg_types, attributes, constants)
+    ptx, _, _, _ = _triton.code_gen.ttir_to_ptx(module, 80, num_warps=4, version=11040)
+    assert 'ld.global.v4.b32' in ptx
+    assert 'st.global.v4.b32' in ptx
+
+
+@pytest.mark.parametrize("dtype, x_order, y_order", [
+    (dtype, x_order, y_order)
+    for dtype in ['float16', 'float32']
+    for x_order, y_order in [('col', 'col'), ('col', 'row'), ('row', 'col')]
+])
+def test_copy_2d(dtype, x_order, y_order, device='cuda'):
+    M, N = 64, 64
+
+    def empty(order):
+        ret = torch.empty((M, N), dtype=getattr(torch, dtype), device=device)
+        return ret.t().contiguous().t() if order == 'col' else ret
+    x = empty(x_order)
+    x.copy_(torch.randn((M, N), dtype=x.dtype, device=device))
+    y = empty(y_order)
+    _copy_2d[(1,)](x, y, x.stride(0), x.stride(1), y.stride(0), y.stride(1), BLOCK_M=M, BLOCK_N=N)
+    assert torch.equal(x, y)
+
+
+@triton.jit
+def _dot_store(A, B, C, M: tl.constexpr, N: tl.constexpr, K: tl.constexpr, OUT_F16: tl.constexpr):
+    rm = tl.arange(0, M)
+    rn = tl.arange(0, N)
+    rk = tl.arange(0, K)
+    a = tl.load(A + rm[:, None] * K + rk[None, :])
+    b = tl.load(B + rk[:, None] * N + rn[None, :])
+    c = tl.dot(a, b)
+    if OUT_F16:
+        c = c.to(tl.float16)
+    tl.store(C + rm[:, None] * N + rn[None, :], c)
+
+
+@pytest.mark.parametrize("dtype", ['f16', 'f32'])
+def test_dot_store_ptx(dtype):
+    # 64-bit stores of f32 pairs fill the sectors touched by a quad, and are
+    # issued straight from the MMA layout. f16 pairs only fill half of
+    # them: going through shared memory is cheaper
+    arg_types = [('ptr', 'f16'), ('ptr', 'f16'), ('ptr', dtype)]
+    constants = {3: 64, 4: 64, 5: 32, 6: dtype == 'f16'}
+    context = _triton.ir.context()
+    module = _dot_store._generate_ttir(context, arg_types, {0: 16, 1: 16, 2: 16}, constants)
+    ptx, _, _, _ = _triton.code_gen.ttir_to_ptx(module, 80, num_warps=4, version=11040)
+    epilogue = ptx[ptx.rindex('mma.sync'):]
+    if dtype == 'f32':
+        assert 'st.shared' not in epilogue
+        assert 'bar.sync' not in epilogue
+        assert 'st.global.v2.b32' in epilogue
+    else:
+        assert 'st.shared' in epilogue
+
+
+@pytest.mark.parametrize("dtype", ['float16', 'float32'])
+def test_dot_store(dtype, device='cuda'):
+    M, N, K = 64, 64, 32
+    a = torch.randn((M, K), dtype=torch.float16, device=device)
+    b = torch.randn((K, N), dtype=torch.float16, device=device)
+    c = torch.empty((M, N), dtype=getattr(torch, dtype), device=device)
+    _dot_store[(1,)](a, b, c, M=M, N=N, K=K, OUT_F16=dtype == 'float16')
+    ref = torch.matmul(a.float(), b.float()).to(c.dtype)
+    triton.testing.assert_almost_equal(c, ref, decimal=2)
@@ -0,0 +1,65 @@
+import re
+
+import pytest
+
+import triton
+import triton._C.libtriton.triton as _triton
+import triton.language as tl
+
+# Pipelined kernels are compiled to PTX for sm_80 without being run, so
+# that these tests need no GPU. Barrier counts are read from the report
+# printed with `TRITON_CODEGEN_STATS`.
+
+
+@triton.jit
+def _matmul(A, B, C, K, BLOCK: tl.constexpr, BLOCK_K: tl.constexpr):
+    rm = tl.arange(0, BLOCK)
+    rn = tl.arange(0, BLOCK)
+    rk = tl.arange(0, BLOCK_K)
+    a_ptrs = A + rm[:, None] * K + rk[None, :]
+    b_ptrs = B + rk[:, None] * BLOCK + rn[None, :]
+    acc = tl.zeros((BLOCK, BLOCK), dtype=tl.float32)
+    for k in range(0, K, BLOCK_K):
+        acc += tl.dot(tl.load(a_ptrs), tl.load(b_ptrs))
+        a_ptrs += BLOCK_K
+        b_ptrs += BLOCK_K * BLOCK
+    tl.store(C + rm[:, None] * BLOCK + rn[None, :], acc)
+
+
+def _compile(num_stages):
+    arg_types = [('ptr', 'f16'), ('ptr', 'f16'), ('ptr', 'f32'), ('scalar', 'i32')]
+    context = _triton.ir.context()
+    module = _matmul._generate_ttir(context, arg_types, {0: 16, 1: 16, 2: 16, 3: 16}, {4: 64, 5: 32})
+    ptx, _, _, _ = _triton.code_gen.ttir_to_ptx(module, 80, num_warps=4, num_stages=num_stages, version=11040)
+    return ptx
+
+
+@pytest.mark.parametrize("num_stages", [2, 3, 4])
+def test_barrier_after_async_wait(num_stages):
+    # data copied asynchronously by other threads is only visible after
+    # the barrier that follows the wait, even when another barrier
+    # precedes the wait
+    ptx = _compile(num_stages)
+    lines = [line.strip() for line in ptx.splitlines()]
+    waits = [i for i, line in enumerate(lines) if line.startswith('cp.async.wait_group')]
+    assert waits
+    for i in waits:
+        # first synchronization or shared memory read after the wait
+        nxt = next(line for line in lines[i + 1:]
+                   if line.startswith(('bar.sync', 'ld.shared', 'ldmatrix')))
+        assert nxt.startswith('bar.sync')
+
+
+@pytest.mark.parametrize("num_stages", [1, 2, 3, 4])
+def test_barrier_count(num_stages, capfd, monkeypatch):
+    # barriers erased and put back while the analysis iterates are counted
+    # once. The f32 accumulator is stored straight from the MMA layout, so
+    # every barrier of the kernel comes from membar
+    monkeypatch.setenv('TRITON_CODEGEN_STATS', '1')
+    ptx = _compile(num_stages)
+    # membar: <kernel>: <n> barrier(s) inserted, <m> barrier(s)/async wait(s) removed
+    stats = [line for line in capfd.readouterr().err.splitlines() if line.startswith('membar: ')]
+    assert len(stats) == 1
+    inserted, removed = map(int, re.findall(r'(\d+) barrier', stats[0]))
+    assert inserted == len(re.findall(r'bar\.sync', ptx))
+    assert removed == 0
@@ -0,0 +1,161 @@
+# flake8: noqa: F821
+import re
+
+import pytest
+import torch
+
+import triton
+import triton._C.libtriton.triton as _triton
+import triton.language as tl
+from triton.code_gen import JITFunction
+
+# Reductions are compiled to PTX for sm_80 without being run, so that
+# these tests need no GPU (except `test_reduce_col_major` and
+# `test_reduce_fused_values`).
+
+
+@triton.jit
+def _kernel(X, Z, BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, AXIS: tl.constexpr):
+    range_m = tl.arange(0, BLOCK_M)
+    range_n = tl.arange(0, BLOCK_N)
+    x = tl.load(X + range_m[:, None] * BLOCK_N + range_n[None, :])
+    z = GENERATE_TEST_HERE
+    if AXIS == 1:
+        tl.store(Z + range_m, z)
+    else:
+        tl.store(Z + range_n, z)
+
+
+def _ptx(op, dtype, shape, axis, num_warps):
+    kernel = JITFunction(_kernel.fn)
+    kernel.src = kernel.src.replace('GENERATE_TEST_HERE', f'tl.{op}(x, axis=AXIS)')
+    z_dtype = 'i32' if op in ['argmin', 'argmax'] else dtype
+    arg_types = [('ptr', dtype), ('ptr', z_dtype)]
+    constants = {2: shape[0], 3: shape[1], 4: axis}
+    context = _triton.ir.context()
+    module = kernel._generate_ttir(context, arg_types, {0: 16, 1: 16}, constants)
+    ptx, shared, _, _ = _triton.code_gen.ttir_to_ptx(module, 80, num_warps, version=11040)
+    return ptx, shared
+
+
+ops = ['sum', 'min', 'max', 'argmin', 'argmax']
+
+
+@pytest.mark.parametrize("op, dtype, shape", [
+    (op, dtype, shape)
+    for op in ops
+    for dtype in ['f16', 'f32', 'i32']
+    for shape in [(1, 128), (4, 64), (16, 32)]
+])
+def test_reduce_single_warp(op, dtype, shape):
+    # threads of a single warp exchange partial results through shuffles
+    ptx, shared = _ptx(op, dtype, shape, 1, num_warps=1)
+    assert 'shfl.sync.bfly' in ptx
+    assert 'bar.sync' not in ptx
+    assert shared == 0
+
+
+@pytest.mark.parametrize("op, dtype, shape, axis", [
+    (op, dtype, shape, axis)
+    for op in ops
+    for dtype in ['f16', 'f32', 'i32', 'f64']
+    for shape, axis in [((1, 4096), 1), ((4, 1024), 1), ((128, 32), 0)]
+])
+def test_reduce_multi_warp(op, dtype, shape, axis):
+    # partial results of each warp go through shared memory once
+    ptx, shared = _ptx(op, dtype, shape, axis, num_warps=4)
+    assert len(re.findall(r'bar\.sync', ptx)) <= 1
+    assert shared > 0
+    if op in ['argmin', 'argmax'] and dtype != 'f64':
+        # indices are packed with values
+        assert re.search(r'st\.shared\.[bu]64', ptx)
+        assert not re.search(r'st\.shared\.[bu]32', ptx)
+
+
+@triton.jit
+def _kernel_col(X, Z, BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr, AXIS: tl.constexpr):
+    # column-major: dimension 0 is contiguous, and the layout order is (0, 1)
+    range_m = tl.arange(0, BLOCK_M)
+    range_n = tl.arange(0, BLOCK_N)
+    x = tl.load(X + range_m[:, None] + range_n[None, :] * BLOCK_M)
+    z = tl.sum(x, axis=AXIS)
+    if AXIS == 1:
+        tl.store(Z + range_m, z)
+    else:
+        tl.store(Z + range_n, z)
+
+
+@pytest.mark.parametrize("shape, axis, num_warps", [
+    ((1024, 4), 0, 4), ((512, 16), 0, 8), ((4, 1024), 1, 4), ((16, 512), 1, 8)
+])
+def test_reduce_col_major_ptx(shape, axis, num_warps):
+    # the reduced axis spans several warps, whether or not it is ord[0]
+    arg_types = [('ptr', 'f32'), ('ptr', 'f32')]
+    context = _triton.ir.context()
+    module = _kernel_col._generate_ttir(context, arg_types, {0: 16, 1: 16}, {2: shape[0], 3: shape[1], 4: axis})
+    ptx, shared, _, _ = _triton.code_gen.ttir_to_ptx(module, 80, num_warps, version=11040)
+    assert 'shfl.sync.bfly' in ptx
+    assert len(re.findall(r'bar\.sync', ptx)) <= 1
+    assert shared > 0
+
+
+@pytest.mark.parametrize("shape, axis, num_warps", [
+    ((1024, 4), 0, 4), ((512, 16), 0, 8), ((4, 1024), 1, 4), ((16, 512), 1, 8), ((128, 32), 0, 4)
+])
+def test_reduce_col_major(shape, axis, num_warps):
+    x = torch.randn(shape, dtype=torch.float32, device='cuda')
+    z = torch.empty(shape[1 - axis], dtype=torch.float32, device='cuda')
+    # column-major storage of `x`
+    _kernel_col[(1, )](x.t().contiguous(), z, BLOCK_M=shape[0], BLOCK_N=shape[1], AXIS=axis, num_warps=num_warps)
+    triton.testing.assert_almost_equal(z, x.sum(axis=axis))
+
+
+@triton.jit
+def _moments(X, Z, BLOCK: tl.constexpr, FUSE: tl.constexpr):
+    x = tl.load(X + tl.arange(0, BLOCK))
+    mean = tl.sum(x, axis=0) / BLOCK
+    if FUSE:
+        # does not depend on `mean`
+        msq = tl.sum(x * x, axis=0) / BLOCK
+    else:
+        msq = tl.sum((x - mean) * (x - mean), axis=0) / BLOCK
+    tl.store(Z, mean)
+    tl.store(Z + 1, msq)
+
+
+@pytest.mark.parametrize("fuse, dtype", [
+    (fuse, dtype)
+    for fuse in [False, True]
+    for dtype in ['f16', 'f32']
+])
+def test_reduce_fused(fuse, dtype):
+    # sibling reductions exchange their partial results together,
+    # dependent reductions cannot
+    arg_types = [('ptr', dtype), ('ptr', dtype)]
+    context = _triton.ir.context()
+    module = _moments._generate_ttir(context, arg_types, {0: 16, 1: 16}, {2: 4096, 3: fuse})
+    ptx, _, _, _ = _triton.code_gen.ttir_to_ptx(module, 80, 4, version=11040)
+    n_barriers = len(re.findall(r'bar\.sync', ptx))
+    if fuse:
+        assert n_barriers == 1
+    else:
+        assert n_barriers >= 2
+
+
+@pytest.mark.parametrize("fuse, dtype", [
+    (fuse, dtype)
+    for fuse in [False, True]
+    for dtype in ['float16', 'float32']
+])
+def test_reduce_fused_values(fuse, dtype):
+    # fused reductions must not mix up each other's partial results
+    BLOCK = 4096
+    x = torch.randn(BLOCK, dtype=getattr(torch, dtype), device='cuda')
+    z = torch.empty(2, dtype=x.dtype, device='cuda')
+    _moments[(1, )](x, z, BLOCK=BLOCK, FUSE=fuse, num_warps=4)
+    ref = x.float()
+    mean = ref.mean()
+    msq = (ref * ref).mean() if fuse else ((ref - mean) * (ref - mean)).mean()
+    # sums of 4096 squares are accumulated in half precision
+    decimal = 1 if dtype == 'float16' else 3
+    triton.testing.assert_almost_equal(z, torch.stack([mean, msq]).to(x.dtype), decimal=decimal)
@@ -0,0 +1,198 @@
+import itertools
+import os
+import re
+import shutil
+import subprocess
+
+import pytest
+import torch
+
+import triton
+import triton._C.libtriton.triton as _triton
+import triton.language as tl
+
+
+def test_prune_spilling_configs():
+    N = 1024 * 64
+
+    @triton.autotune(configs=[triton.Config({'BLOCK': N}, num_warps=1),
+                              triton.Config({'BLOCK': 1024}, num_warps=4)],
+                     key=['N'])
+    @triton.jit
+    def _kernel(Y, X, N, BLOCK: tl.constexpr):
+        offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+        x = tl.load(X + offs)
+        tl.store(Y + offs, x * x + x)
+
+    x = torch.randn(N, dtype=torch.float32, device='cuda')
+    y = torch.empty_like(x)
+    grid = lambda META: (triton.cdiv(N, META['BLOCK']), )
+    _kernel[grid](y, x, N)
+    triton.testing.assert_almost_equal(y, x * x + x)
+    # each thread would hold 2048 elements of x in the first config
+    timings = {c.kwargs['BLOCK']: t for c, t in _kernel.kernel.configs_timings.items()}
+    assert timings[N][0] == float('inf')
+    assert timings[1024][0] < float('inf')
+    # both configs are compiled before benchmarking
+    assert _kernel.kernel.bench_time.compile > 0
+    assert _kernel.kernel.bench_time.bench > 0
+
+
+@pytest.mark.parametrize("reject_spilling", [False, True])
+def test_spilling_fallback(reject_spilling):
+    N = 1024 * 64
+
+    # all configs spill: they are timed rather than failing
+    @triton.autotune(configs=[triton.Config({'BLOCK': N}, num_warps=1),
+                              triton.Config({'BLOCK': N // 2}, num_warps=1)],
+                     key=['N'], reject_spilling=reject_spilling)
+    @triton.jit
+    def _kernel(Y, X, N, BLOCK: tl.constexpr):
+        offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+        x = tl.load(X + offs)
+        tl.store(Y + offs, x * x + x)
+
+    x = torch.randn(N, dtype=torch.float32, device='cuda')
+    y = torch.empty_like(x)
+    grid = lambda META: (triton.cdiv(N, META['BLOCK']), )
+    _kernel[grid](y, x, N)
+    triton.testing.assert_almost_equal(y, x * x + x)
+    assert all(t[0] < float('inf') for t in _kernel.kernel.configs_timings.values())
+
+
+def _ptxas():
+    path = os.environ.get('TRITON_PTXAS_PATH')
+    for ptxas in [path + 'ptxas' if path else None, '/usr/local/cuda/bin/ptxas', shutil.which('ptxas')]:
+        if ptxas and os.path.isfile(ptxas):
+            return ptxas
+    pytest.skip('ptxas not found')
+
+
+@triton.jit
+def _axpy(Y, X, N, BLOCK: tl.constexpr):
+    offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+    mask = offs < N
+    x = tl.load(X + offs, mask=mask)
+    y = tl.load(Y + offs, mask=mask)
+    tl.store(Y + offs, 2 * x + y, mask=mask)
+
+
+@pytest.mark.parametrize("block", [1024, 2048, 4096, 8192])
+def test_register_estimate(block, tmp_path):
+    # no GPU: the estimate of `ttir_to_ptx` against `ptxas -v`
+    ptxas = _ptxas()
+    arg_types = [('ptr', 'f32'), ('ptr', 'f32'), ('scalar', 'i32')]
+    context = _triton.ir.context()
+    module = _axpy._generate_ttir(context, arg_types, {0: 16, 1: 16, 2: 16}, {3: block})
+    ptx, _, estimate, _ = _triton.code_gen.ttir_to_ptx(module, 80, num_warps=4, version=11040)
+    src = tmp_path / 'axpy.ptx'
+    src.write_text(ptx)
+    out = subprocess.run([ptxas, '-v', '--gpu-name=sm_80', str(src), '-o', str(tmp_path / 'axpy.cubin')],
+                         capture_output=True, text=True, check=True)
+    used = int(re.search(r'Used (\d+) registers', out.stdout + out.stderr).group(1))
+    # configs are only rejected when the estimate exceeds the budget by
+    # `margin`: it must not overestimate ptxas by more than that
+    assert 0 < estimate <= triton.code_gen._reject_spilling.margin * used
+
+
+def test_register_estimate_rejected():
+    # no GPU: configs bound to spill stop before isel, and no LLVM-IR is generated
+    arg_types = [('ptr', 'f32'), ('ptr', 'f32'), ('scalar', 'i32')]
+    compiled = dict()
+    for max_regs in [0, 16]:
+        context = _triton.ir.context()
+        module = _axpy._generate_ttir(context, arg_types, {0: 16, 1: 16, 2: 16}, {3: 8192})
+        compiled[max_regs] = _triton.code_gen.ttir_to_ptx(module, 80, num_warps=1, version=11040, max_regs=max_regs)
+    ptx, _, estimate, timings = compiled[0]
+    assert ptx and 'isel' in dict(timings)
+    ptx, _, rejected_estimate, timings = compiled[16]
+    assert rejected_estimate == estimate > 16
+    assert ptx == ''
+    assert 'registers' in dict(timings)
+    assert 'isel' not in dict(timings)
+    assert 'link_extern_libs' not in dict(timings)
+
+
+def test_autotune_db(tmp_path, monkeypatch):
+    monkeypatch.setenv('TRITON_CACHE_DIR', str(tmp_path / 'a'))
+
+    @triton.autotune(configs=[triton.Config({'BLOCK': 128}, num_warps=4),
+                              triton.Config({'BLOCK': 1024}, num_warps=4)],
+                     key=['N'])
+    @triton.jit
+    def _kernel(Y, X, N, BLOCK: tl.constexpr):
+        offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+        tl.store(Y + offs, tl.load(X + offs, mask=offs < N), mask=offs < N)
+
+    N = 4096
+    x = torch.randn(N, dtype=torch.float32, device='cuda')
+    y = torch.empty_like(x)
+    grid = lambda META: (triton.cdiv(N, META['BLOCK']), )
+    _kernel[grid](y, x, N)
+    best = _kernel.kernel.best_config
+    assert _kernel.kernel.bench_time.bench > 0
+    # a new process finds the result of the first one
+    _kernel.kernel = None
+    _kernel[grid](y, x, N)
+    assert _kernel.kernel.bench_time == (0, 0)
+    assert _kernel.kernel.best_config is best
+    # another machine imports it
+    exported = str(tmp_path / 'exported.json')
+    triton.code_gen.autotune_db().export(exported)
+    monkeypatch.setenv('TRITON_CACHE_DIR', str(tmp_path / 'b'))
+    triton.code_gen.autotune_db().merge(exported)
+    _kernel.kernel = None
+    _kernel[grid](y, x, N)
+    assert _kernel.kernel.bench_time == (0, 0)
+    assert _kernel.kernel.best_config is best
+
+
+def test_autotune_db_read_once(tmp_path):
+    # no GPU: lookups are served from memory after the first one
+    db = triton.code_gen.AutotuneDB(str(tmp_path / 'autotune.json'))
+    entry = dict(kernel='k', kernel_key='0', timing=1.0)
+    db.put('a', entry)
+    reads = []
+    read = db._read
+    db._read = lambda: reads.append(1) or read()
+    assert db.get('a')['timing'] == 1.0
+    assert db.get('b') is None
+    assert db.get('c') is None
+    assert reads == []
+    # another process finds the file
+    other = triton.code_gen.AutotuneDB(str(tmp_path / 'autotune.json'))
+    assert other.get('a')['timing'] == 1.0
+
+
+def test_autotune_non_json_kwargs():
+    # no GPU: kwargs that are not JSON values are recorded by their repr
+    configs = [triton.Config({'ACTIVATION': tl.float16, 'BLOCK': 128}),
+               triton.Config({'ACTIVATION': tl.float32, 'BLOCK': 128})]
+    tuner = triton.code_gen.Autotuner(None, ['N'], configs, ['N'], None)
+    assert triton.code_gen._config_to_dict(configs[0])['kwargs'] == {'ACTIVATION': repr(tl.float16), 'BLOCK': 128}
+    other = triton.code_gen.Autotuner(None, ['N'], configs[:1], ['N'], None)
+    assert tuner.config_space_hash != other.config_space_hash
+
+
+@pytest.mark.parametrize("search", [triton.SuccessiveHalving(), triton.RandomSearch(0.5),
+                                    triton.LocalSearch(), triton.LocalSearch(16)])
+def test_search(search):
+    # no GPU: synthetic running times, with a single minimum
+    configs = [triton.Config({'BLOCK_M': m, 'BLOCK_N': n}, num_warps=w)
+               for m, n, w in itertools.product([16, 32, 64, 128], [16, 32, 64, 128], [2, 4, 8])]
+    cost = lambda c: abs(c.kwargs['BLOCK_M'] - 64) + abs(c.kwargs['BLOCK_N'] - 32) + c.num_warps
+    benched = []
+
+    def bench(configs, rep=100):
+        benched.extend(configs)
+        return {c: (cost(c), cost(c), cost(c)) for c in configs}
+    estimate = lambda c: cost(c) + c.kwargs['BLOCK_M']
+    timings = search(configs, bench, estimate)
+    assert set(timings) == set(benched)
+    best = min(timings, key=timings.get)
+    if isinstance(search, triton.RandomSearch):
+        assert len(benched) == len(configs) // 2
+    else:
+        assert cost(best) == 2
+    if isinstance(search, triton.LocalSearch):
+        assert len(set(benched)) <= min(16, len(configs) // 2)
@@ -1,3 +1,5 @@
+import concurrent.futures
+import hashlib
 import os
 import re
 import shutil
@@ -8,6 +10,7 @@ import torch
 import triton
 import triton.language as tl
 from triton.code_gen import JITFunction
+from triton.tools.cache import CacheStore
 
 tmpdir = ".tmp"
 
@@ -150,3 +153,285 @@ def test_constexpr_not_callable() -> None:
     except BaseException:
         error = True
     assert error is True
+
+
+@pytest.mark.parametrize("mode", ['block', 'generic', 'fallback'])
+def test_compile_async(mode):
+    @triton.jit
+    def kernel(X, i, BLOCK: tl.constexpr):
+        tl.store(X, i)
+
+    def fallback(X, i, BLOCK, grid):
+        X.fill_(i)
+
+    JITFunction.cache_hook = None
+    reset_tmp_dir()
+    compile_async = {'block': 'block', 'generic': 'generic', 'fallback': fallback}[mode]
+    x = torch.zeros(1, dtype=torch.int32, device='cuda')
+    ret = kernel[(1,)](x, 16, BLOCK=128, compile_async=compile_async)
+    assert x.item() == 16
+    if mode == 'block':
+        assert isinstance(ret, triton.code_gen.LoadedBinary)
+        return
+    # the first launch does not wait for the specialized kernel
+    assert len(kernel.bin_cache) == {'generic': 1, 'fallback': 0}[mode]
+    ret.result()
+    x.zero_()
+    ret = kernel[(1,)](x, 16, BLOCK=128, compile_async=compile_async)
+    assert isinstance(ret, triton.code_gen.LoadedBinary)
+    assert x.item() == 16
+    assert len(kernel.bin_cache) == {'generic': 2, 'fallback': 1}[mode]
+
+
+def test_launch_cache_collision():
+    # hash(-1) == hash(-2): hits of the launch cache are checked
+    # against the whole key
+    @triton.jit
+    def kernel(X, C: tl.constexpr):
+        tl.store(X, C)
+
+    JITFunction.cache_hook = None
+    reset_tmp_dir()
+    x = torch.zeros(1, dtype=torch.int32, device='cuda')
+    assert hash(-1) == hash(-2)
+    for c in [-1, -2, -1, -2]:
+        kernel[(1,)](x, C=c)
+        assert x.item() == c
+    assert len(kernel.bin_cache) == 2
+    assert len(kernel.launch_cache) == 2
+
+
+def test_launch_cache_float_constexpr():
+    # constexprs are keyed by their repr: -0.0 has its own kernel, and
+    # NaN finds the kernel it was compiled to
+    @triton.jit
+    def kernel(X, C: tl.constexpr):
+        tl.store(X, C)
+
+    JITFunction.cache_hook = None
+    reset_tmp_dir()
+    x = torch.zeros(1, dtype=torch.float32, device='cuda')
+    for c in [0.0, -0.0, float('nan'), 0.0, -0.0, float('nan')]:
+        kernel[(1,)](x, C=c)
+    assert len(kernel.bin_cache) == 3
+    assert len(kernel.launch_cache) == 3
+
+
+def test_launch_cache_pointer_alignment():
+    # pointers are specialized on the alignment of their address only,
+    # the same way whether the launch cache hits or not
+    @triton.jit
+    def kernel(X):
+        tl.store(X, 1)
+
+    JITFunction.cache_hook = None
+    reset_tmp_dir()
+    x = torch.zeros(8, dtype=torch.int32, device='cuda')
+    for offset in [0, 1, 0, 1, 4]:
+        kernel[(1,)](x[offset:])
+    # 16 and 4 bytes
+    assert len(kernel.bin_cache) == 2
+    assert len(kernel.launch_cache) == 2
+    assert x[:5].tolist() == [1, 1, 0, 0, 1]
+
+
+def test_compile_async_generic(monkeypatch):
+    # the generic kernel makes no assumption on the values of arguments
+    class Pool:
+        submitted = []
+
+        def submit(self, fn):
+            # the generic kernel is submitted first and compiled,
+            # specialized kernels are never ready
+            future = concurrent.futures.Future()
+            if not self.submitted:
+                future.set_result(fn())
+            self.submitted.append(fn)
+            return future
+    pool = Pool()
+    monkeypatch.setattr(triton.code_gen, 'compile_pool', lambda: pool)
+
+    @triton.jit
+    def kernel(X, Y, N, BLOCK: tl.constexpr):
+        offs = tl.arange(0, BLOCK)
+        mask = offs < N
+        tl.store(Y + offs, tl.load(X + offs, mask=mask), mask=mask)
+
+    JITFunction.cache_hook = None
+    reset_tmp_dir()
+    x = torch.arange(1, 129, dtype=torch.int32, device='cuda')
+    y = torch.zeros(128, dtype=torch.int32, device='cuda')
+    # aligned pointers, N == 1
+    kernel[(1,)](x, y, 1, BLOCK=128, compile_async='generic')
+    assert torch.equal(y[:1], x[:1]) and (y[1:] == 0).all()
+    # misaligned pointers, N != 1
+    y.zero_()
+    kernel[(1,)](x[1:], y[1:], 37, BLOCK=128, compile_async='generic')
+    assert torch.equal(y[1:38], x[1:38]) and (y[38:] == 0).all()
+    assert len(kernel.bin_cache) == 1
+    # the generic kernel, then two specialized ones
+    assert len(pool.submitted) == 3
+    assert pool.submitted[0].args[2]['attributes'] == {}
+
+
+def test_cache_store_lru(tmp_path):
+    store = CacheStore(str(tmp_path), max_bytes=64 * 1024, num_slots=64)
+    for i in range(16):
+        store.put(f'key{i}', bytes([i]) * 1024)
+    for i in range(64):
+        store.put(f'big{i}', bytes(4096))
+        # keep the first entry hot
+        assert store.get('key0') == bytes([0]) * 1024
+    assert store.get('key1') is None
+    assert store.get('big63') == bytes(4096)
+    size = sum(os.path.getsize(tmp_path / f) for f in os.listdir(tmp_path) if f.startswith('data.'))
+    assert size <= 2 * 1024 * 1024
+    # other processes (and the next one) see the same entries
+    assert CacheStore(str(tmp_path), max_bytes=64 * 1024, num_slots=64).get('big63') == bytes(4096)
+
+
+def test_cache_store_fork(tmp_path):
+    # a forked child neither shares the index descriptor of its parent
+    # nor deadlocks on a lock its parent held when it forked
+    store = CacheStore(str(tmp_path), max_bytes=64 * 1024, num_slots=64)
+    store.put('parent', b'1')
+    with store.lock:
+        pid = os.fork()
+        if pid == 0:
+            ok = store.get('parent') == b'1' and store.pid == os.getpid()
+            store.put('child', b'2')
+            os._exit(0 if ok else 1)
+    _, status = os.waitpid(pid, 0)
+    assert os.WIFEXITED(status) and os.WEXITSTATUS(status) == 0
+    assert store.get('child') == b'2'
+    assert store.pid == os.getpid()
+
+
+def test_cache_store_legacy(tmp_path):
+    # binaries of previous versions are moved to the store
+    store = CacheStore(str(tmp_path), max_bytes=64 * 1024, num_slots=64)
+    path = tmp_path / hashlib.md5(b'key').hexdigest()
+    path.write_bytes(b'binary')
+    assert JITFunction._load_legacy('key', store) == b'binary'
+    assert not path.exists()
+    assert store.get('key') == b'binary'
+    assert JITFunction._load_legacy('key', store) is None
+
+
+def test_stage_cache(monkeypatch):
+    puts = []
+
+    class StageCache(triton.code_gen._StageCache):
+        def put(self, key, value):
+            puts.append(key)
+            super().put(key, value)
+    monkeypatch.setattr(triton.code_gen, '_StageCache', StageCache)
+    JITFunction.cache_hook = None
+    reset_tmp_dir()
+    x = torch.empty(128, dtype=torch.int32, device='cuda')
+
+    @triton.jit
+    def kernel(X, BLOCK: tl.constexpr):
+        tl.store(X + tl.arange(0, BLOCK), 1)
+    kernel[(1,)](x, BLOCK=128)
+    assert [key.split('-')[1] for key in puts] == ['llir', 'ptx', 'cubin']
+
+    @triton.jit
+    def kernel(X, BLOCK: tl.constexpr):
+        # different source hash, same Triton-IR
+        tl.store(X + tl.arange(0, BLOCK), 1)
+    kernel[(1,)](x, BLOCK=128)
+    assert len(puts) == 3
+
+
+def test_stage_cache_attributes(monkeypatch):
+    # kernels whose Triton-IR differs only in instruction attributes
+    # do not share stages
+    puts = []
+
+    class StageCache(triton.code_gen._StageCache):
+        def put(self, key, value):
+            puts.append(key)
+            super().put(key, value)
+    monkeypatch.setattr(triton.code_gen, '_StageCache', StageCache)
+    JITFunction.cache_hook = None
+    reset_tmp_dir()
+    x = torch.arange(128, dtype=torch.float32, device='cuda')
+    z = torch.empty(1, dtype=torch.float32, device='cuda')
+
+    @triton.jit
+    def kernel(X, Z, BLOCK: tl.constexpr):
+        tl.store(Z, tl.sum(tl.load(X + tl.arange(0, BLOCK)), axis=0))
+    kernel[(1,)](x, z, BLOCK=128)
+    assert z.item() == x.sum().item()
+
+    @triton.jit
+    def kernel(X, Z, BLOCK: tl.constexpr):
+        tl.store(Z, tl.max(tl.load(X + tl.arange(0, BLOCK)), axis=0))
+    kernel[(1,)](x, z, BLOCK=128)
+    assert z.item() == x.max().item()
+    assert [key.split('-')[1] for key in puts] == ['llir', 'ptx', 'cubin'] * 2
+
+
+@pytest.mark.parametrize("keep_ir", [False, True])
+def test_keep_ir(keep_ir, monkeypatch):
+    monkeypatch.setenv('TRITON_KEEP_IR', '1' if keep_ir else '0')
+    JITFunction.cache_hook = None
+    reset_tmp_dir()
+    x = torch.empty(128, dtype=torch.int32, device='cuda')
+
+    @triton.jit
+    def kernel(X, BLOCK: tl.constexpr):
+        tl.store(X + tl.arange(0, BLOCK), 1)
+    pgm = kernel[(1,)](x, BLOCK=128)
+    assert ('ttir' in pgm.asm) == keep_ir
+    assert ('llir' in pgm.asm) == keep_ir
+    # regenerated on access
+    assert 'store' in pgm.asm['ttir']
+    assert 'define' in pgm.asm['llir']
+    assert 'ttir' in pgm.asm
+
+
+def test_precompile(tmp_path):
+    manifest = str(tmp_path / "manifest")
+    JITFunction.cache_hook = None
+    reset_tmp_dir()
+    kernel.bin_cache.clear()
+    kernel.launch_cache.clear()
+    triton.record_manifest(manifest)
+    x = torch.empty(1, dtype=torch.int32, device='cuda')
+    try:
+        kernel[(1,)](x, 5, BLOCK=1024)
+        kernel[(1,)](x, 8, BLOCK=256)
+    finally:
+        triton.record_manifest(None)
+    # fresh process: empty in-memory and on-disk caches
+    reset_tmp_dir()
+    kernel.bin_cache.clear()
+    kernel.launch_cache.clear()
+    assert triton.precompile(manifest, workers=2) == 2
+    assert len(kernel.bin_cache) == 2
+    counter = 0
+
+    def inc_counter(*args, **kwargs):
+        nonlocal counter
+        counter += 1
+    JITFunction.cache_hook = inc_counter
+    kernel[(1,)](x, 5, BLOCK=1024)
+    kernel[(1,)](x, 8, BLOCK=256)
+    JITFunction.cache_hook = None
+    assert counter == 0
+
+
+def test_version_key(tmp_path, monkeypatch):
+    monkeypatch.setenv('TRITON_CACHE_DIR', str(tmp_path))
+    monkeypatch.setattr(triton.code_gen, '_version_keys', None)
+    key = triton.code_gen.version_key()
+    assert len(os.listdir(tmp_path / 'version_keys')) == 1
+
+    # another process only stats the files
+    def compute(*args):
+        assert False
+    monkeypatch.setattr(triton.code_gen, '_version_keys', None)
+    monkeypatch.setattr(triton.code_gen, '_compute_version_keys', compute)
+    assert triton.code_gen.version_key() == key
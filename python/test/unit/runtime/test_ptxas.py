@@ -0,0 +1,78 @@
+import os
+import stat
+
+import pytest
+
+import triton._C.libtriton.triton as _triton
+
+# `ptxas` is replaced by a script through `TRITON_PTXAS_PATH`,
+# so that these tests need neither CUDA nor a GPU.
+
+_stub = """#!/bin/sh
+if [ "$1" = "--version" ]; then
+  echo "x" >> {count}
+  echo "Cuda compilation tools, release 11.4, V11.4.48"
+  exit 0
+fi
+echo "$@" > {args}
+while [ $# -gt 0 ]; do
+  case "$1" in
+    -o) out="$2"; shift;;
+    -*) ;;
+    *) src="$1";;
+  esac
+  shift
+done
+if grep -q invalid "$src"; then
+  echo "ptxas fatal: invalid PTX" >&2
+  exit 1
+fi
+if grep -q verbose "$src"; then
+  cat "$src" >&2
+  exit 1
+fi
+echo "ptxas info: 8 registers" >&2
+cat "$src" > "$out"
+"""
+
+
+@pytest.fixture
+def ptxas(tmp_path, monkeypatch):
+    path = tmp_path / "ptxas"
+    path.write_text(_stub.format(count=tmp_path / "count", args=tmp_path / "args"))
+    path.chmod(path.stat().st_mode | stat.S_IEXEC)
+    monkeypatch.setenv("TRITON_PTXAS_PATH", str(tmp_path) + os.sep)
+    return tmp_path
+
+
+def test_ptx_to_cubin(ptxas):
+    # the PTX and the binary go through in-memory files: larger than
+    # the buffer the binary is read back with
+    ptx = "// " + "x" * (1 << 20)
+    assert _triton.code_gen.ptx_to_cubin(ptx, 80) == (ptx + "\n").encode()
+    assert _triton.code_gen.ptx_to_cubin(ptx, 80) == (ptx + "\n").encode()
+    # looked up once per process
+    assert (ptxas / "count").read_text() == "x\n"
+
+
+def test_ptx_to_cubin_error(ptxas):
+    with pytest.raises(RuntimeError, match="ptxas fatal: invalid PTX"):
+        _triton.code_gen.ptx_to_cubin("invalid", 80)
+
+
+def test_ptx_to_cubin_large_log(ptxas):
+    # the log goes through a pipe: larger than its buffer, so that ptxas
+    # blocks unless the log is read while it runs
+    ptx = "// verbose " + "x" * (1 << 20)
+    with pytest.raises(RuntimeError) as e:
+        _triton.code_gen.ptx_to_cubin(ptx, 80)
+    assert ptx in str(e.value)
+
+
+@pytest.mark.parametrize("opt_level", [0, 1, 2, 3])
+def test_ptx_to_cubin_opt_level(ptxas, opt_level):
+    _triton.code_gen.ptx_to_cubin("// ptx", 80, opt_level=opt_level)
+    args = (ptxas / "args").read_text().split()
+    # ptxas defaults to -O3
+    expected = [] if opt_level == 3 else [f"-O{opt_level}"]
+    assert [a for a in args if a.startswith("-O")] == expected
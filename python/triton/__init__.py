@@ -7,7 +7,8 @@ __version__ = '2.0.0'
 import torch
 # submodules
 from .code_gen import cdiv, next_power_of_2, jit, autotune, heuristics, \
-    JITFunction, Config, Autotuner, reinterpret
+    JITFunction, Config, Autotuner, reinterpret, precompile, record_manifest
+from .tools.search import Exhaustive, SuccessiveHalving, RandomSearch, LocalSearch
 from . import language
 from . import code_gen
 from . import testing
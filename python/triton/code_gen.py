@@ -1,12 +1,18 @@
 from __future__ import annotations
 
 import ast
+import atexit
 import builtins
+import collections
+import contextlib
 import functools
 import hashlib
+import importlib
 import inspect
+import json
 import os
 import pickle
+import shutil
 import subprocess
 import sys
 import tempfile
@@ -21,7 +27,10 @@ from filelock import FileLock
 
 import triton
 import triton._C.libtriton.triton as _triton
+from .tools.autotune_db import AutotuneDB
+from .tools.cache import CacheStore
 from .tools.disasm import extract
+from .tools.search import Exhaustive
 
 try:
     from torch._C import _cuda_getCurrentRawStream as get_cuda_stream
@@ -758,13 +767,43 @@ class CodeGenerator(ast.NodeVisitor):
         raise NotImplementedError("Unsupported node: {}".format(typename))
 
 
+class _Asm(dict):
+    '''
+    Assembly of a binary. Unless `TRITON_KEEP_IR` is set, kernels are compiled
+    without recording the text of their Triton-IR and LLVM-IR, which is
+    regenerated the first time it is accessed.
+    '''
+
+    def __init__(self, asm, regenerate=None):
+        super().__init__(asm)
+        self.regenerate = regenerate
+
+    def __missing__(self, key):
+        if key not in ('ttir', 'llir') or self.regenerate is None:
+            raise KeyError(key)
+        asm = self.regenerate()
+        self['ttir'] = asm['ttir']
+        self['llir'] = asm['llir']
+        return self[key]
+
+    def __reduce__(self):
+        # binaries are pickled to the cache without the kernel that regenerates them
+        return (_Asm, (dict(self), ))
+
+
+def _keep_ir():
+    return os.environ.get('TRITON_KEEP_IR', '0') == '1'
+
+
 class Binary:
-    def __init__(self, backend, name, asm, shared_mem, num_warps):
+    def __init__(self, backend, name, asm, shared_mem, num_warps, n_regs_estimate=0):
         self.backend = backend
         self.name = name
         self.asm = asm
         self.shared_mem = shared_mem
         self.num_warps = num_warps
+        # registers per thread, as predicted before PTX generation
+        self.n_regs_estimate = n_regs_estimate
 
 
 class LoadedBinary:
@@ -818,6 +857,65 @@ class CompilationError(Exception):
         return (type(self), (self.src, self.node))
 
 
+def max_registers(num_warps):
+    # per-thread register budget before ptxas has to spill
+    return builtins.min(255, 65536 // (num_warps * 32))
+
+
+class _RejectSpilling(threading.local):
+    '''
+    While enabled, compilations whose estimated register usage exceeds
+    `margin` times the budget stop before PTX generation and raise
+    OutOfResources.
+    '''
+    enabled = False
+    # The estimate is the number of 32-bit values live at the same time in
+    # Triton-IR. ptxas may use fewer registers (rematerialization, packed
+    # 16-bit values) or more (address computations), so only configs well
+    # over the budget are rejected (see test_register_estimate)
+    margin = 1.5
+
+    def __enter__(self):
+        self.prev, self.enabled = self.enabled, True
+
+    def __exit__(self, *args):
+        self.enabled = self.prev
+
+
+_reject_spilling = _RejectSpilling()
+
+
+_compile_pool = None
+_compile_pool_lock = threading.Lock()
+
+
+def compile_pool():
+    '''
+    Background threads that run the compilations of `compile_async`
+    launches. Their number can be set with `TRITON_COMPILE_WORKERS`.
+    '''
+    global _compile_pool
+    with _compile_pool_lock:
+        if _compile_pool is None:
+            num_workers = int(os.environ.get('TRITON_COMPILE_WORKERS', builtins.min(8, os.cpu_count() or 1)))
+            _compile_pool = _triton.runtime.compile_pool(num_workers)
+            atexit.register(_compile_pool.shutdown)
+    return _compile_pool
+
+
+def _compiled(future):
+    '''
+    Binary compiled by `future`, or None when it was rejected as spilling and
+    the current launch does not reject spilling configs
+    '''
+    try:
+        return future.result()
+    except OutOfResources as e:
+        if e.name != "registers" or _reject_spilling.enabled:
+            raise
+        return None
+
+
 class OutOfResources(Exception):
     def __init__(self, required, limit, name):
         self.message = f'out of resource: {name}, '\
@@ -933,31 +1031,54 @@ class Kernel:
         self.fn = fn
         self.cache_key = {}
 
-    def add_to_cache(self, key, wargs, device_idx, num_warps, num_stages, extern_libs):
+    def add_to_cache(self, key, wargs, device_idx, num_warps, num_stages, extern_libs, compile_pool=None, opt_level=3,
+                     do_not_specialize=None):
+        # `do_not_specialize` must be the one `key` was computed with
+        if do_not_specialize is None:
+            do_not_specialize = self.fn.do_not_specialize
+        # already being compiled in the background
+        future = self.fn.compile_futures.pop(key, None) if compile_pool is None else None
+        binary = None if future is None else _compiled(future)
+        if binary is not None:
+            self.fn.bin_cache[key] = LoadedBinary(device_idx, binary)
+            return False
         tensor_idxs = [i for i, arg in enumerate(wargs) if hasattr(arg, 'data_ptr')]
 
         # attributes
         attributes = dict()
         for i, arg in enumerate(wargs):
-            if i in self.fn.do_not_specialize:
+            if i in do_not_specialize:
                 continue
             if isinstance(arg, int):
                 attributes[i] = Kernel.pow2_divisor(arg)
             elif i in tensor_idxs:
-                addr = arg.data_ptr()
-                range_size = _triton.runtime.get_pointer_range_size(addr)
-                attributes[i] = min(Kernel.pow2_divisor(addr),
-                                    Kernel.pow2_divisor(range_size))
+                attributes[i] = Kernel.pow2_divisor(arg.data_ptr())
         # transforms ints whose value is one into constants for just-in-time compilation
-        constants = {i: arg for i, arg in enumerate(wargs) if isinstance(arg, int) and arg == 1 and i not in self.fn.do_not_specialize}
+        constants = {i: arg for i, arg in enumerate(wargs) if isinstance(arg, int) and arg == 1 and i not in do_not_specialize}
         constants.update({i: arg.value for i, arg in enumerate(wargs) if isinstance(arg, triton.language.constexpr)})
         constants.update({i: None for i, arg in enumerate(wargs) if arg is None})
         arg_types = [Kernel._to_python_ir(arg) for i, arg in enumerate(wargs) if i not in constants]
         return self.fn._warmup(key, arg_types=arg_types, device=device_idx, attributes=attributes, constants=constants, num_warps=num_warps, num_stages=num_stages,
-                               extern_libs=extern_libs, is_manual_warmup=False)
+                               extern_libs=extern_libs, is_manual_warmup=False, compile_pool=compile_pool, opt_level=opt_level)
 
-    def __call__(self, *wargs, grid, num_warps=4, num_stages=2, extern_libs={}, **kwargs):
+    def __call__(self, *wargs, grid, num_warps=4, num_stages=2, extern_libs={}, compile_async=None, opt_level=3, **kwargs):
+        '''
+        :param opt_level: optimization level of LLVM and ptxas, from 0 to 3. Lower levels
+            compile faster, e.g., for kernels that are rarely launched.
+        :param compile_async: when set, kernels missing from the cache are compiled in the background
+            and the launch returns a future instead of blocking. Until the future is ready, the launch:
+            - `'block'`: waits for it without holding the GIL,
+            - `'generic'`: runs the kernel compiled without specialization on argument values
+              (e.g., divisibility). It is submitted to the compile pool ahead of the specialized
+              kernel, so that the first launch only waits for it, and is found in the on-disk
+              cache (or loaded by `triton.precompile`) afterwards,
+            - a callable: calls it with the same arguments and `grid`.
+        '''
         assert num_warps != 0 and (num_warps & (num_warps - 1)) == 0, f"num_warps={num_warps} must be a power of 2."
+        if not (compile_async in (None, 'block', 'generic') or callable(compile_async)):
+            raise ValueError(f"invalid value for compile_async: {compile_async}")
+        if opt_level not in (0, 1, 2, 3):
+            raise ValueError(f"invalid value for opt_level: {opt_level}")
         # handle arguments passed by name
         kwargs = {self.fn.arg_names.index(name): value for name, value in kwargs.items()}
         wargs = list(wargs)
@@ -965,6 +1086,7 @@ class Kernel:
             wargs.insert(pos + i, kwargs[pos])
         if len(wargs) != len(self.fn.arg_names):
             raise TypeError(f"Function takes {len(self.fn.arg_names)} positional arguments but {len(wargs)} were given")
+        args = list(wargs)
         # handle annotations
         for pos, _type in self.fn.annotations.items():
             assert _type == triton.language.constexpr, "only constexpr annotations are supported for now"
@@ -979,15 +1101,93 @@ class Kernel:
         # no way to know if this function should or shouldn't initialize the cuda context
         # so we're being conservative here
         torch.cuda.set_device(device)
-        if device not in self.cache_key:
+        if (device, opt_level) not in self.cache_key:
             cc = torch.cuda.get_device_capability(device)
             cc = str(cc[0]) + '-' + str(cc[1])
-            self.cache_key[device] = self.fn.cache_key + cc
-        cache_key = self.cache_key[device]
+            # the default level keeps the keys of existing binaries
+            self.cache_key[device, opt_level] = self.fn.cache_key + cc + ('' if opt_level == 3 else f'-O{opt_level}')
+        cache_key = self.cache_key[device, opt_level]
         stream = current_cuda_stream(device)
-        return _triton.runtime.launch(wargs, self.fn.do_not_specialize, cache_key, self.fn.arg_names,
-                                      device, stream, self.fn.bin_cache, num_warps, num_stages, extern_libs, self.add_to_cache,
-                                      grid)
+        add_to_cache = self.add_to_cache if opt_level == 3 else functools.partial(self.add_to_cache, opt_level=opt_level)
+        if compile_async is None:
+            return _triton.runtime.launch(wargs, self.fn.do_not_specialize, cache_key, self.fn.arg_names,
+                                          device, stream, self.fn.bin_cache, num_warps, num_stages, extern_libs, add_to_cache,
+                                          grid, self.fn.launch_cache)
+        generic = None
+        if compile_async == 'generic':
+            do_not_specialize = list(range(len(wargs)))
+
+            def generic(block, grid):
+                return _triton.runtime.launch(wargs, do_not_specialize, cache_key, self.fn.arg_names,
+                                              device, stream, self.fn.bin_cache, num_warps, num_stages, extern_libs,
+                                              _AsyncCompile(self, block=block, opt_level=opt_level,
+                                                            do_not_specialize=do_not_specialize),
+                                              grid, self.fn.launch_cache)
+        # an empty grid submits the generic kernel without launching it
+        submit_generic = None if generic is None else functools.partial(generic, False, (0, ))
+        add_to_cache = _AsyncCompile(self, block=compile_async == 'block', opt_level=opt_level,
+                                     before_submit=submit_generic)
+        bin = _triton.runtime.launch(wargs, self.fn.do_not_specialize, cache_key, self.fn.arg_names,
+                                     device, stream, self.fn.bin_cache, num_warps, num_stages, extern_libs, add_to_cache,
+                                     grid, self.fn.launch_cache)
+        if add_to_cache.future is None:
+            return bin
+        if generic is not None:
+            # only waits for the generic kernel
+            generic(True, grid)
+        else:
+            compile_async(*args, grid=grid)
+        return add_to_cache.future
+
+
+class _AsyncCompile:
+    '''
+    `add_to_cache` of `compile_async` launches: submits missing kernels
+    to the compile pool and records the future the launch is waiting on.
+    `before_submit` is called before a kernel is submitted, and
+    `do_not_specialize` is the one the launch key was computed with
+    '''
+
+    def __init__(self, kernel, block, opt_level=3, do_not_specialize=None, before_submit=None):
+        self.kernel = kernel
+        self.block = block
+        self.opt_level = opt_level
+        self.do_not_specialize = do_not_specialize
+        self.before_submit = before_submit
+        self.future = None
+
+    def add_to_cache(self, key, wargs, device_idx, num_warps, num_stages, extern_libs):
+        # synchronous compilation
+        return self.kernel.add_to_cache(key, wargs, device_idx, num_warps, num_stages, extern_libs,
+                                        opt_level=self.opt_level, do_not_specialize=self.do_not_specialize)
+
+    def __call__(self, key, wargs, device_idx, num_warps, num_stages, extern_libs):
+        fn = self.kernel.fn
+        future = fn.compile_futures.get(key)
+        if future is None:
+            if self.before_submit is not None:
+                self.before_submit()
+            if not self.kernel.add_to_cache(key, wargs, device_idx, num_warps, num_stages, extern_libs,
+                                            compile_pool=compile_pool(), opt_level=self.opt_level,
+                                            do_not_specialize=self.do_not_specialize):
+                # found in the on-disk cache
+                return False
+            future = fn.compile_futures.get(key)
+            # skipped by `cache_hook`
+            if future is None:
+                return True
+        if not self.block and not future.done():
+            self.future = future
+            return True
+        # compilation errors are raised here, and the
+        # kernel is compiled again on the next launch
+        fn.compile_futures.pop(key, None)
+        if key not in fn.bin_cache:
+            binary = _compiled(future)
+            if binary is None:
+                return self.add_to_cache(key, wargs, device_idx, num_warps, num_stages, extern_libs)
+            fn.bin_cache[key] = LoadedBinary(device_idx, binary)
+        return False
 
 
 class Launcher:
@@ -999,13 +1199,52 @@ class Launcher:
         return self.kernel(*wargs, **kwargs, grid=self.grid)
 
 
+def _config_to_dict(config):
+    # kwargs that are not JSON values are recorded by their repr
+    ret = dict(kwargs=config.kwargs, num_warps=config.num_warps, num_stages=config.num_stages)
+    return json.loads(json.dumps(ret, default=repr))
+
+
+_autotune_dbs = dict()
+
+
+def autotune_db():
+    '''
+    Autotuning results of all processes using `TRITON_CACHE_DIR`. They
+    expire after `TRITON_AUTOTUNE_TTL` seconds, if set. Returns None when
+    `TRITON_CACHE_DIR` is empty.
+    '''
+    cache_dir = os.environ.get('TRITON_CACHE_DIR', default_cache_dir())
+    if not cache_dir:
+        return None
+    ttl = os.environ.get('TRITON_AUTOTUNE_TTL')
+    ttl = None if ttl is None else float(ttl)
+    key = (cache_dir, ttl)
+    if key not in _autotune_dbs:
+        _autotune_dbs[key] = AutotuneDB(os.path.join(cache_dir, "autotune.json"), ttl)
+    return _autotune_dbs[key]
+
+
+# time spent by the autotuner compiling and benchmarking configs
+BenchTime = collections.namedtuple('BenchTime', ['compile', 'bench'])
+
+
+def _skip_launch(*args, **kwargs):
+    pass
+
+
 class Autotuner:
-    def __init__(self, kernel, arg_names, configs, key, reset_to_zero, prune_configs_by: Dict = None):
+    def __init__(self, kernel, arg_names, configs, key, reset_to_zero, prune_configs_by: Dict = None, fn=None, search=None,
+                 reject_spilling=True):
         '''
         :param prune_configs_by: a dict of functions that are used to prune configs, fields:
             'perf_model': performance model used to predicate running time with different configs, returns running time
             'top_k': number of configs to bench
             'prune_num_stages_by'(optional): a function used to prune num_stages. It take configs:List[Config] as its input, and returns pruned configs.
+        :param fn: the tuned JIT function. When given, results are persisted in :code:`autotune_db()`.
+        :param search: strategy picking the configs to benchmark among the pruned ones (see `triton.tools.search`).
+            Defaults to benchmarking all of them.
+        :param reject_spilling: whether configs predicted to spill registers are skipped.
         '''
         if not configs:
             self.configs = [Config(dict(), num_warps=4, num_stages=2)]
@@ -1033,8 +1272,47 @@ class Autotuner:
             perf_model, top_k, early_config_prune = None, None, None
         self.perf_model, self.configs_top_k = perf_model, top_k
         self.early_config_prune = early_config_prune
+        self.fn = fn
+        self.search = Exhaustive() if search is None else search
+        self.reject_spilling = reject_spilling
+        config_space = json.dumps(sorted(json.dumps(_config_to_dict(c), sort_keys=True) for c in self.configs))
+        self.config_space_hash = hashlib.md5(config_space.encode("utf-8")).hexdigest()
+
+    def _db_key(self, key):
+        device = torch.cuda.current_device()
+        key_args = [str(arg.dtype) if hasattr(arg, 'data_ptr') else repr(arg) for arg in key]
+        db_key = [self.fn.src_key, torch.cuda.get_device_name(device), str(torch.cuda.get_device_capability(device)),
+                  *key_args, self.config_space_hash]
+        return hashlib.md5('-'.join(db_key).encode("utf-8")).hexdigest()
+
+    def _load(self, key):
+        db = autotune_db() if self.fn is not None else None
+        if db is None:
+            return False
+        entry = db.get(self._db_key(key))
+        if entry is None:
+            return False
+        configs = {json.dumps(_config_to_dict(c), sort_keys=True): c for c in self.configs}
+        timings = {configs.get(json.dumps(c, sort_keys=True)): tuple(t) for c, t in entry['timings']}
+        best = configs.get(json.dumps(entry['config'], sort_keys=True))
+        if best is None or None in timings:
+            return False
+        self.cache[key] = best
+        self.configs_timings = timings
+        self.bench_time = BenchTime(compile=0, bench=0)
+        return True
+
+    def _save(self, key, timings):
+        db = autotune_db() if self.fn is not None else None
+        if db is None:
+            return
+        best = self.cache[key]
+        db.put(self._db_key(key), dict(kernel=f'{self.fn.module}.{self.fn.__name__}', kernel_key=self.fn.src_key,
+                                       config=_config_to_dict(best), timing=timings[best][0],
+                                       timings=[(_config_to_dict(c), t) for c, t in timings.items()]))
 
-    def _bench(self, *args, config, **meta):
+    @staticmethod
+    def _meta(config, meta):
         # check for conflicts, i.e. meta-parameters both provided
         # as kwargs and by the autotuner
         conflicts = meta.keys() & config.kwargs.keys()
@@ -1044,20 +1322,74 @@ class Autotuner:
                 " Make sure that you don't re-define auto-tuned symbols."
             )
         # augment meta-parameters with tunable ones
-        current = dict(meta, **config.kwargs)
+        return dict(meta, **config.kwargs)
+
+    def _compile_all(self, args, configs, meta, reject_spilling):
+        '''
+        Compiles `configs` on the compile pool. Returns the configs that use
+        too much shared memory, and those predicted to spill registers when
+        `reject_spilling` is set: they are not worth compiling and timing
+        '''
+        futures = dict()
+        rejected, spilling = [], []
+
+        def reject(config, e):
+            (spilling if e.name == "registers" else rejected).append(config)
+        for config in configs:
+            # empty grid: nothing is launched
+            current = dict(self._meta(config, meta), grid=(0, ))
+            try:
+                with _reject_spilling if reject_spilling else contextlib.nullcontext():
+                    ret = self.kernel(*args, num_warps=config.num_warps, num_stages=config.num_stages,
+                                      compile_async=_skip_launch, **current)
+            except OutOfResources as e:
+                reject(config, e)
+                continue
+            if isinstance(ret, _triton.runtime.compile_future):
+                futures[config] = ret
+        for config, future in futures.items():
+            try:
+                future.result()
+            except OutOfResources as e:
+                reject(config, e)
+        return rejected, spilling
+
+    def _bench(self, *args, config, rep, **meta):
+        current = self._meta(config, meta)
 
         def kernel_call():
             if config.pre_hook:
                 config.pre_hook(self.nargs)
             self.hook(args)
             self.kernel(*args, num_warps=config.num_warps, num_stages=config.num_stages, **current)
-        return triton.testing.do_bench(kernel_call)
+        return triton.testing.do_bench(kernel_call, warmup=min(25, rep), rep=rep)
+
+    def _bench_all(self, args, meta, configs, rep=100):
+        compile_start = time.time()
+        rejected, spilling = self._compile_all(args, configs, meta, self.reject_spilling)
+        if spilling and len(rejected) + len(spilling) == len(configs):
+            # the estimate may be wrong: rather than failing, the
+            # configs predicted to spill are timed
+            rejected += self._compile_all(args, spilling, meta, False)[0]
+        else:
+            rejected += spilling
+        bench_start = time.time()
+        timings = {config: self._bench(*args, config=config, rep=rep, **meta)
+                   for config in configs if config not in rejected}
+        bench_end = time.time()
+        timings.update({config: (float('inf'), float('inf'), float('inf')) for config in rejected})
+        self.bench_time = BenchTime(compile=self.bench_time.compile + bench_start - compile_start,
+                                    bench=self.bench_time.bench + bench_end - bench_start)
+        return timings
+
+    def _estimate(self, config, meta):
+        return self.perf_model(**self.nargs, **meta, **config.kwargs, num_stages=config.num_stages, num_warps=config.num_warps)
 
     def __call__(self, *args, **kwargs):
         self.nargs = dict(zip(self.arg_names, args))
         if len(self.configs) > 1:
             key = tuple([args[i] for i in self.key_idx])
-            if key not in self.cache:
+            if key not in self.cache and not self._load(key):
                 # prune configs
                 pruned_configs = self.configs
                 if self.early_config_prune:
@@ -1067,16 +1399,15 @@ class Autotuner:
                     if isinstance(top_k, float) and top_k <= 1.0:
                         top_k = int(len(self.configs) * top_k)
                     if len(pruned_configs) > top_k:
-                        est_timing = {config: self.perf_model(**self.nargs, **kwargs, **config.kwargs, num_stages=config.num_stages, num_warps=config.num_warps) for config in pruned_configs}
+                        est_timing = {config: self._estimate(config, kwargs) for config in pruned_configs}
                         pruned_configs = sorted(est_timing.keys(), key=lambda x: est_timing[x])[:top_k]
-                bench_start = time.time()
-                timings = {config: self._bench(*args, config=config, **kwargs)
-                           for config in pruned_configs}
-                bench_end = time.time()
-                self.bench_time = bench_end - bench_start
+                estimate = functools.partial(self._estimate, meta=kwargs) if self.perf_model else None
+                self.bench_time = BenchTime(compile=0, bench=0)
+                timings = self.search(pruned_configs, functools.partial(self._bench_all, args, kwargs), estimate)
                 self.cache[key] = builtins.min(timings, key=timings.get)
                 self.hook(args)
                 self.configs_timings = timings
+                self._save(key, timings)
             config = self.cache[key]
         else:
             config = self.configs[0]
@@ -1087,39 +1418,88 @@ class Autotuner:
 
 
 _version_key_lock = threading.Lock()
-_version_key = None
-
+_version_keys = None
 
-def version_key():
-    global _version_key
 
-    if _version_key is not None:
-        return _version_key
+def _file_stat(path):
+    try:
+        st = os.stat(path)
+    except (OSError, TypeError):
+        return None
+    return [path, st.st_size, st.st_mtime_ns]
+
+
+def _compute_version_keys(paths, ptxas):
+    def md5(path):
+        with open(path, "rb") as f:
+            return hashlib.md5(f.read()).hexdigest()
+    # frontend, backend and language
+    frontend, backend, *language = [md5(path) for path in paths]
+    contents = [frontend, backend] + language
+    # ptxas version
+    try:
+        ptxas_version = hashlib.md5(subprocess.check_output([ptxas, "--version"])).hexdigest()
+    except Exception:
+        ptxas_version = ''
+    return {'backend': backend,
+            'version': '-'.join(triton.__version__) + '-' + ptxas_version + '-' + '-'.join(contents)}
+
+
+def _get_version_keys():
+    '''
+    Hashes of the backend and of everything kernels are compiled with. Hashing
+    them is slow, so they are cached in `TRITON_CACHE_DIR` by the path, size and
+    modification time of the files involved and of ptxas.
+    '''
+    global _version_keys
+
+    if _version_keys is not None:
+        return _version_keys
 
     with _version_key_lock:
-        if _version_key is not None:
-            return _version_key
+        if _version_keys is not None:
+            return _version_keys
 
         import pkgutil
-        contents = []
-        # frontend
-        with open(triton.code_gen.__file__, "rb") as f:
-            contents += [hashlib.md5(f.read()).hexdigest()]
-        # backend
-        with open(triton._C.libtriton.__file__, "rb") as f:
-            contents += [hashlib.md5(f.read()).hexdigest()]
-        # language
+        paths = [triton.code_gen.__file__, triton._C.libtriton.__file__]
         language_path = os.path.join(*triton.__path__, 'language')
         for lib in pkgutil.iter_modules([language_path]):
-            with open(lib.module_finder.find_spec(lib.name).origin, "rb") as f:
-                contents += [hashlib.md5(f.read()).hexdigest()]
-        # ptxas version
-        try:
-            ptxas_version = hashlib.md5(subprocess.check_output(["ptxas", "--version"])).hexdigest()
-        except Exception:
-            ptxas_version = ''
-        _version_key = '-'.join(triton.__version__) + '-' + ptxas_version + '-' + '-'.join(contents)
-        return _version_key
+            paths += [lib.module_finder.find_spec(lib.name).origin]
+        ptxas = shutil.which("ptxas")
+        stats = json.dumps([_file_stat(path) for path in paths + [ptxas]])
+        cache_dir = os.environ.get('TRITON_CACHE_DIR', default_cache_dir())
+        cache_path = None
+        if cache_dir:
+            cache_path = os.path.join(cache_dir, "version_keys", hashlib.md5(stats.encode("utf-8")).hexdigest())
+            try:
+                with open(cache_path) as f:
+                    keys = json.load(f)
+                if keys['stats'] == stats:
+                    _version_keys = keys
+                    return _version_keys
+            except (OSError, ValueError, KeyError):
+                pass
+        keys = _compute_version_keys(paths, ptxas or "ptxas")
+        keys['stats'] = stats
+        if cache_path is not None:
+            try:
+                os.makedirs(os.path.dirname(cache_path), exist_ok=True)
+                tmp = f"{cache_path}.{os.getpid()}.tmp"
+                with open(tmp, "w") as f:
+                    json.dump(keys, f)
+                os.replace(tmp, cache_path)
+            except OSError:
+                pass
+        _version_keys = keys
+        return _version_keys
+
+
+def backend_key():
+    return _get_version_keys()['backend']
+
+
+def version_key():
+    return _get_version_keys()['version']
 
 
 class DependenciesFinder(ast.NodeVisitor):
@@ -1162,6 +1542,43 @@ def default_cache_dir():
     return os.path.join(os.environ["HOME"], ".triton", "cache")
 
 
+_cache_stores = dict()
+
+
+def cache_store():
+    '''
+    Store of compiled kernels in `TRITON_CACHE_DIR`, holding at most
+    `TRITON_CACHE_MAX_SIZE` bytes (1GB by default) and evicting the least
+    recently used ones. Returns None when `TRITON_CACHE_DIR` is empty.
+    '''
+    cache_dir = os.environ.get('TRITON_CACHE_DIR', default_cache_dir())
+    if not cache_dir:
+        return None
+    max_bytes = int(os.environ.get('TRITON_CACHE_MAX_SIZE', 1 << 30))
+    key = (cache_dir, max_bytes)
+    if key not in _cache_stores:
+        _cache_stores[key] = CacheStore(cache_dir, max_bytes)
+    return _cache_stores[key]
+
+
+class _StageCache:
+    '''
+    Results of the stages of `compile_ttir` (LLVM-IR, PTX, cubin), keyed
+    by the hash of their input. They only depend on the backend, so
+    kernels with different source hashes may share them.
+    '''
+
+    def __init__(self, store):
+        self.store = store
+        self.prefix = backend_key() + '-'
+
+    def get(self, key):
+        return self.store.get(self.prefix + key)
+
+    def put(self, key, value):
+        self.store.put(self.prefix + key, value)
+
+
 class JITFunction:
 
     cache_hook = None
@@ -1182,6 +1599,11 @@ class JITFunction:
         self.do_not_specialize = [self.arg_names.index(arg) if isinstance(arg, str) else arg for arg in self.do_not_specialize]
         # cache for callable driver objects (e.g. CUkernel)
         self.bin_cache = dict()
+        # same, indexed by a hash of the launch arguments; it is
+        # checked first and `bin_cache` is only used on a miss
+        self.launch_cache = _triton.runtime.launch_cache()
+        # pending background compilations
+        self.compile_futures = dict()
         self.hash = None
         # JITFunction can be instantiated as kernel
         # when called with a grid using __getitem__
@@ -1218,6 +1640,11 @@ class JITFunction:
         assert isinstance(tree.body[0], ast.FunctionDef)
         return tree
 
+    @property
+    def src_key(self):
+        # `cache_key` without the version of the compiler
+        return self.cache_key[:-len(version_key())]
+
     def __call__(self, *args, **kwargs):
         raise RuntimeError("Cannot call @triton.jit'd outside of the scope of a kernel.")
 
@@ -1243,29 +1670,21 @@ class JITFunction:
     def warmup(self, compile):
         return self._warmup(**compile, is_manual_warmup=True)
 
-    def _warmup(self, key, arg_types, device, attributes, constants, num_warps, num_stages, extern_libs, is_manual_warmup):
-        hashed_key = hashlib.md5(key.encode("utf-8")).hexdigest()
-
-        # create cache directory
-        cache_dir = os.environ.get('TRITON_CACHE_DIR', default_cache_dir())
-        if cache_dir:
-            os.makedirs(cache_dir, exist_ok=True)
-
-        if cache_dir:
-            bin_cache_path = os.path.join(cache_dir, hashed_key)
-            bin_lock_path = bin_cache_path + ".lock"
-        else:
-            bin_cache_path = None
-            bin_lock_path = None
-
+    def _warmup(self, key, arg_types, device, attributes, constants, num_warps, num_stages, extern_libs, is_manual_warmup, compile_pool=None,
+                opt_level=3):
+        store = cache_store()
         binary = None
-        if bin_cache_path and os.path.exists(bin_cache_path):
-            assert bin_lock_path is not None
-            with FileLock(bin_lock_path):
-                with open(bin_cache_path, 'rb') as f:
-                    binary = pickle.load(f)["binary"]
-
-        compile = dict(arg_types=arg_types, device=device, attributes=attributes, constants=constants, num_warps=num_warps, num_stages=num_stages, extern_libs=extern_libs)
+        if store is not None:
+            data = store.get(key)
+            if data is None:
+                data = self._load_legacy(key, store)
+            if data is not None:
+                binary = pickle.loads(data)["binary"]
+
+        compile = dict(arg_types=arg_types, device=device, attributes=attributes, constants=constants, num_warps=num_warps, num_stages=num_stages, extern_libs=extern_libs,
+                       opt_level=opt_level)
+        if binary is not None:
+            binary.asm = _Asm(binary.asm, regenerate=functools.partial(self._regenerate_ir, compile))
         if JITFunction.cache_hook is not None:
             name = self.__name__
             info = key.split('-')[-3:]
@@ -1281,22 +1700,59 @@ class JITFunction:
             if noop:
                 return True
 
-        if binary is None:
-            binary = self._compile(**compile)
+        if not is_manual_warmup:
+            _record_in_manifest(self, key, compile)
+
+        if binary is None and compile_pool is not None:
+            # loaded by the next launch once compiled
+            self.compile_futures[key] = compile_pool.submit(
+                functools.partial(self._compile_and_save, key, store, compile, _reject_spilling.enabled))
+            return True
 
-        if bin_cache_path:
-            assert bin_lock_path is not None
-            with FileLock(bin_lock_path):
-                with open(bin_cache_path + ".tmp", "wb") as f:
-                    pickle.dump({"binary": binary, "key": key}, f)
-                os.rename(bin_cache_path + ".tmp", bin_cache_path)
+        if binary is None:
+            binary = self._compile_and_save(key, store, compile)
 
         self.bin_cache[key] = LoadedBinary(device, binary)
         return False
 
-    def _compile(self, arg_types, device, attributes, constants, num_warps, num_stages, extern_libs):
-        # create IR module
-        context = _triton.ir.context()
+    def _compile_and_save(self, key, store, compile, reject_spilling=False):
+        if reject_spilling:
+            with _reject_spilling:
+                binary = self._compile(**compile)
+        else:
+            binary = self._compile(**compile)
+        if store is not None:
+            store.put(key, pickle.dumps({"binary": binary, "key": key}))
+        binary.asm = _Asm(binary.asm, regenerate=functools.partial(self._regenerate_ir, compile))
+        return binary
+
+    @staticmethod
+    def _load_legacy(key, store):
+        # binaries cached in their own file by previous versions
+        # are moved to the store the first time they are used
+        path = os.path.join(store.path, hashlib.md5(key.encode("utf-8")).hexdigest())
+        if not os.path.exists(path):
+            return None
+        with FileLock(path + ".lock"):
+            try:
+                with open(path, 'rb') as f:
+                    data = f.read()
+            except FileNotFoundError:
+                # moved by another process
+                return store.get(key)
+            store.put(key, data)
+            os.remove(path)
+        try:
+            os.remove(path + ".lock")
+        except OSError:
+            pass
+        return data
+
+    def _regenerate_ir(self, compile):
+        # stages cached on disk are not compiled again
+        return self._compile(**compile, keep_ir=True).asm
+
+    def _generate_ttir(self, context, arg_types, attributes, constants):
         # get just-in-time proto-type of kernel
         arg_types = [Kernel._to_triton_ir(arg) for arg in arg_types]
         ret_type = triton.language.void
@@ -1312,16 +1768,30 @@ class JITFunction:
             if node is None or isinstance(e, (NotImplementedError, CompilationError)):
                 raise e
             raise CompilationError(self.src, node) from e
+        return generator.module
+
+    def _compile(self, arg_types, device, attributes, constants, num_warps, num_stages, extern_libs, opt_level=3, keep_ir=None):
+        # create IR module
+        context = _triton.ir.context()
+        module = self._generate_ttir(context, arg_types, attributes, constants)
         # Compile to machine code
         if torch.version.hip is None:
             backend = _triton.runtime.backend.CUDA
         else:
             backend = _triton.runtime.backend.ROCM
-        name, asm, shared_mem = _triton.code_gen.compile_ttir(backend, generator.module, device, num_warps, num_stages, extern_libs)
+        max_regs = int(max_registers(num_warps) * _reject_spilling.margin) if _reject_spilling.enabled else 0
+        store = cache_store()
+        stage_cache = None if store is None else _StageCache(store)
+        if keep_ir is None:
+            keep_ir = _keep_ir()
+        name, asm, shared_mem, n_regs_estimate = _triton.code_gen.compile_ttir(backend, module, device, num_warps, num_stages, extern_libs,
+                                                                               max_regs, stage_cache, opt_level, keep_ir)
         max_shared_memory = _triton.runtime.max_shared_memory(backend, device)
         if shared_mem > max_shared_memory:
             raise OutOfResources(shared_mem, max_shared_memory, "shared memory")
-        return Binary(backend, name, asm, shared_mem, num_warps)
+        if max_regs and n_regs_estimate > max_regs:
+            raise OutOfResources(n_regs_estimate, max_regs, "registers")
+        return Binary(backend, name, asm, shared_mem, num_warps, n_regs_estimate)
 
     def __getitem__(self, grid):
         return Launcher(self._init_kernel(), grid)
@@ -1362,7 +1832,7 @@ class Config:
         return ', '.join(res)
 
 
-def autotune(configs, key, prune_configs_by=None, reset_to_zero=None):
+def autotune(configs, key, prune_configs_by=None, reset_to_zero=None, search=None, reject_spilling=True):
     """
     Decorator for auto-tuning a :code:`triton.jit`'d function.
 
@@ -1384,6 +1854,15 @@ def autotune(configs, key, prune_configs_by=None, reset_to_zero=None):
            This means that whatever value the kernel updates will be updated multiple times.
            To avoid this undesired behavior, you can use the `reset_to_zero` argument, which
            reset the value of the provided tensor to `zero` before running any configuration.
+    :note: All configurations are compiled in parallel before being benchmarked (see
+           `TRITON_COMPILE_WORKERS`). Those whose estimated register usage exceeds the per-thread
+           budget by a margin are rejected before PTX generation and are not benchmarked (unless
+           all of them are), and so are those that use too much shared memory. `bench_time`
+           reports compile and benchmark times.
+    :note: Results are persisted in `$TRITON_CACHE_DIR/autotune.json` and reused by other processes
+           for the same kernel source, device, key values and configurations. They expire after
+           `TRITON_AUTOTUNE_TTL` seconds if set, and can be moved between machines with
+           :code:`triton.code_gen.autotune_db().export(path)` and :code:`.merge(path)`.
 
     :param configs: a list of :code:`triton.Config` objects
     :type configs: list[triton.Config]
@@ -1395,10 +1874,16 @@ def autotune(configs, key, prune_configs_by=None, reset_to_zero=None):
         'early_config_prune'(optional): a function used to do early prune (eg, num_stages). It take configs:List[Config] as its input, and returns pruned configs.
     :param reset_to_zero: a list of argument names whose value will be reset to zero before evaluating any configs.
     :type reset_to_zero: list[str]
+    :param search: strategy picking the configurations to benchmark, e.g., :code:`triton.SuccessiveHalving()`
+        (short runs, then longer runs for the fastest configs), :code:`triton.RandomSearch(budget)` or
+        :code:`triton.LocalSearch(budget)` (hill climbing from the best `perf_model` prediction).
+        Defaults to benchmarking all the configurations left after pruning.
+    :param reject_spilling: whether configurations predicted to spill registers are skipped.
     """
     def decorator(fn):
         def wrapper(kernel):
-            return Autotuner(kernel, fn.arg_names, configs, key, reset_to_zero, prune_configs_by)
+            return Autotuner(kernel, fn.arg_names, configs, key, reset_to_zero, prune_configs_by, fn=fn, search=search,
+                             reject_spilling=reject_spilling)
 
         fn.kernel_decorators.append(wrapper)
         return fn
@@ -1466,6 +1951,92 @@ def jit(*args, **kwargs):
 
 ######
 
+_manifest = None
+_manifest_keys = set()
+_manifest_lock = threading.Lock()
+
+
+def record_manifest(manifest):
+    '''
+    Appends the arguments of every kernel compiled or loaded from the cache
+    from now on to the file `manifest`, so that they can be compiled again
+    ahead of time by :code:`precompile`. Recording can also be enabled by
+    setting `TRITON_PRECOMPILE_MANIFEST`, and disabled by passing None.
+    '''
+    global _manifest
+    _manifest = manifest
+
+
+def _record_in_manifest(fn, key, compile):
+    manifest = _manifest or os.environ.get('TRITON_PRECOMPILE_MANIFEST')
+    if not manifest or not key.startswith(fn.cache_key):
+        return
+    with _manifest_lock:
+        if (manifest, key) in _manifest_keys:
+            return
+        _manifest_keys.add((manifest, key))
+    # the source hash is left out: kernels are compiled
+    # again from their current source
+    entry = dict(module=fn.module, name=fn.__name__, key=key[len(fn.cache_key):], compile=compile)
+    with FileLock(manifest + ".lock"):
+        with open(manifest, 'ab') as f:
+            pickle.dump(entry, f)
+
+
+def precompile(manifest, workers=None):
+    '''
+    Compiles the kernels recorded in `manifest` by :code:`record_manifest`
+    on `workers` background threads (one per CPU by default). Binaries are
+    written to the on-disk cache and loaded, so that the first launches of
+    these kernels do not compile.
+
+    :return: the number of kernels that are ready to be launched.
+    '''
+    entries = dict()
+    with FileLock(manifest + ".lock"):
+        with open(manifest, 'rb') as f:
+            while True:
+                try:
+                    entry = pickle.load(f)
+                except EOFError:
+                    break
+                entries[entry['module'], entry['name'], entry['key']] = entry
+    pool = _triton.runtime.compile_pool(workers or os.cpu_count() or 1)
+    pending = []
+    num_ready = 0
+    for entry in entries.values():
+        try:
+            fn = getattr(importlib.import_module(entry['module']), entry['name'])
+        except (ImportError, AttributeError):
+            fn = None
+        if not isinstance(fn, JITFunction):
+            warnings.warn(f"precompile: {entry['module']}.{entry['name']} is not a JIT function")
+            continue
+        key = fn.cache_key + entry['key']
+        if key in fn.bin_cache:
+            num_ready += 1
+        elif not fn._warmup(key, **entry['compile'], is_manual_warmup=True, compile_pool=pool):
+            # loaded from the on-disk cache
+            num_ready += 1
+        elif key in fn.compile_futures:
+            pending.append((fn, key, entry['compile']['device']))
+    for fn, key, device in pending:
+        future = fn.compile_futures.pop(key, None)
+        if future is None:
+            continue
+        try:
+            binary = future.result()
+        except Exception as e:
+            warnings.warn(f"precompile: {fn.__name__} failed to compile: {e}")
+            continue
+        if key not in fn.bin_cache:
+            fn.bin_cache[key] = LoadedBinary(device, binary)
+        num_ready += 1
+    pool.shutdown()
+    return num_ready
+
+######
+
 # class ForwardDeclaration:
 
 #     def __init__(self, name, ret_ty, arg_tys) -> None:
@@ -0,0 +1,90 @@
+import json
+import os
+import time
+
+from filelock import FileLock
+
+# Persistent table of autotuning results, stored as a JSON object in a
+# single file. Writers take a file lock, merge their entries into the
+# current content of the file and replace it atomically, so that
+# concurrent processes do not lose each other's results. The file is read
+# once, on the first lookup: results written by other processes later on
+# are only seen after this process writes its own.
+#
+# Entries are dictionaries with at least:
+#  - `kernel`: name of the tuned kernel,
+#  - `kernel_key`: hash of its source (and dependencies),
+#  - `timing`: the time of the best configuration,
+#  - `time`: when the entry was written.
+
+
+class AutotuneDB:
+    def __init__(self, path, ttl=None):
+        self.path = path
+        self.ttl = ttl
+        # content of the file, once read
+        self._entries = None
+
+    def _expired(self, entry, now):
+        return self.ttl is not None and now - entry['time'] > self.ttl
+
+    def _read(self):
+        try:
+            with open(self.path) as f:
+                return json.load(f)
+        except (FileNotFoundError, ValueError):
+            return dict()
+
+    def _merge(self, entries, new_entries):
+        for key, entry in new_entries.items():
+            # results for other versions of the kernel: the newest version wins
+            others = [k for k, e in entries.items()
+                      if e['kernel'] == entry['kernel'] and e['kernel_key'] != entry['kernel_key']]
+            if any(entries[k]['time'] > entry['time'] for k in others):
+                continue
+            for k in others:
+                del entries[k]
+            # the same problem tuned twice: keep the fastest
+            current = entries.get(key)
+            if current is None or entry['timing'] < current['timing']:
+                entries[key] = entry
+
+    def _update(self, new_entries):
+        os.makedirs(os.path.dirname(os.path.abspath(self.path)), exist_ok=True)
+        with FileLock(self.path + ".lock"):
+            entries = self._read()
+            self._merge(entries, new_entries)
+            now = time.time()
+            entries = {k: e for k, e in entries.items() if not self._expired(e, now)}
+            with open(self.path + ".tmp", "w") as f:
+                json.dump(entries, f, indent=1, sort_keys=True)
+            os.replace(self.path + ".tmp", self.path)
+            self._entries = entries
+
+    def get(self, key):
+        if self._entries is None:
+            self._entries = self._read()
+        entry = self._entries.get(key)
+        if entry is None or self._expired(entry, time.time()):
+            return None
+        return entry
+
+    def put(self, key, entry):
+        entry = dict(entry, time=time.time())
+        self._update({key: entry})
+
+    def export(self, path):
+        '''
+        Writes the (unexpired) entries of the table to `path`
+        '''
+        now = time.time()
+        entries = {k: e for k, e in self._read().items() if not self._expired(e, now)}
+        with open(path, "w") as f:
+            json.dump(entries, f, indent=1, sort_keys=True)
+
+    def merge(self, path):
+        '''
+        Merges the entries exported to `path`, e.g. by another machine
+        '''
+        with open(path) as f:
+            self._update(json.load(f))
@@ -0,0 +1,274 @@
+import fcntl
+import hashlib
+import mmap
+import os
+import struct
+import threading
+import time
+import weakref
+
+# On-disk key-value store for compiled kernels.
+#
+# A directory holds:
+#  - `index`: a header followed by an open-addressing hash table whose slots
+#    map the md5 of a key to a (segment, offset, size, last access) record.
+#    It has a fixed size and is memory-mapped by every process using the store.
+#  - `data.<n>`: append-only segments holding the values. Entries evicted from
+#    the index leave holes that are reclaimed by copying the live entries of
+#    the emptiest segment forward and deleting it.
+#
+# The index is protected by `flock`: shared for lookups, exclusive for updates.
+# Lookups also write the access time of the entry they hit, which may race with
+# other readers; this only makes the LRU order approximate.
+#
+# `flock` locks belong to open file descriptions, which are shared with forked
+# children: a child (e.g., a DataLoader worker) reopens the index instead of
+# using the descriptor of its parent, and gets a new thread lock in case the
+# one of its parent was held when it forked.
+
+_HEADER = struct.Struct('<8sIIQQQ')   # magic, version, number of slots, entries, live bytes, next segment
+_SLOT = struct.Struct('<16sIIQQQ')    # digest, segment, used, offset, size, last access
+_RECORD = struct.Struct('<16sQ')      # digest, size
+_MAGIC = b'TRITONKV'
+_VERSION = 1
+
+
+_stores = weakref.WeakSet()
+
+
+def _after_fork_in_child():
+    for store in _stores:
+        store.lock = threading.Lock()
+
+
+if hasattr(os, 'register_at_fork'):
+    os.register_at_fork(after_in_child=_after_fork_in_child)
+
+
+class CacheStore:
+    def __init__(self, path, max_bytes, num_slots=1 << 16):
+        self.path = path
+        self.max_bytes = max_bytes
+        self.num_slots = num_slots
+        # linear probing degrades past this load factor
+        self.max_entries = num_slots * 3 // 4
+        self.segment_bytes = max(1 << 20, max_bytes // 8)
+        self.lock = threading.Lock()
+        self.index = None
+        self.segments = dict()
+        self.pid = None
+        _stores.add(self)
+
+    # ---------------------------------------
+    # index
+    # ---------------------------------------
+
+    def _open(self):
+        # the index may have been deleted, e.g. by `rm -rf $TRITON_CACHE_DIR`
+        if self.index is not None and self.pid == os.getpid() and os.fstat(self.fd).st_nlink > 0:
+            return
+        self._close()
+        self.pid = os.getpid()
+        os.makedirs(self.path, exist_ok=True)
+        size = _HEADER.size + self.num_slots * _SLOT.size
+        self.fd = os.open(os.path.join(self.path, 'index'), os.O_RDWR | os.O_CREAT, 0o644)
+        fcntl.flock(self.fd, fcntl.LOCK_EX)
+        try:
+            if os.fstat(self.fd).st_size != size:
+                os.ftruncate(self.fd, 0)
+                os.ftruncate(self.fd, size)
+            self.index = mmap.mmap(self.fd, size)
+            magic, version, num_slots = _HEADER.unpack_from(self.index, 0)[:3]
+            if magic != _MAGIC or version != _VERSION or num_slots != self.num_slots:
+                self.index[:] = bytes(size)
+                _HEADER.pack_into(self.index, 0, _MAGIC, _VERSION, self.num_slots, 0, 0, 0)
+        finally:
+            fcntl.flock(self.fd, fcntl.LOCK_UN)
+
+    def _close(self):
+        if self.index is not None:
+            self.index.close()
+            os.close(self.fd)
+        for f in self.segments.values():
+            f.close()
+        self.index = None
+        self.segments = dict()
+
+    def _header(self):
+        return list(_HEADER.unpack_from(self.index, 0))
+
+    def _set_header(self, header):
+        _HEADER.pack_into(self.index, 0, *header)
+
+    def _slot(self, i):
+        return _SLOT.unpack_from(self.index, _HEADER.size + i * _SLOT.size)
+
+    def _set_slot(self, i, slot):
+        _SLOT.pack_into(self.index, _HEADER.size + i * _SLOT.size, *slot)
+
+    def _home(self, digest):
+        return int.from_bytes(digest[:8], 'little') % self.num_slots
+
+    def _find(self, digest):
+        '''
+        Returns the slot holding `digest`, or the free
+        slot where it should be inserted
+        '''
+        i = self._home(digest)
+        while True:
+            slot = self._slot(i)
+            if not slot[2] or slot[0] == digest:
+                return i, slot
+            i = (i + 1) % self.num_slots
+
+    def _erase(self, i):
+        # backward-shift deletion: no tombstones in the table
+        j = i
+        while True:
+            j = (j + 1) % self.num_slots
+            slot = self._slot(j)
+            if not slot[2]:
+                break
+            home = self._home(slot[0])
+            if (j - home) % self.num_slots >= (j - i) % self.num_slots:
+                self._set_slot(i, slot)
+                i = j
+        self._set_slot(i, (bytes(16), 0, 0, 0, 0, 0))
+
+    def _entries(self):
+        for i in range(self.num_slots):
+            slot = self._slot(i)
+            if slot[2]:
+                yield i, slot
+
+    # ---------------------------------------
+    # segments
+    # ---------------------------------------
+
+    def _segment_path(self, segment):
+        return os.path.join(self.path, f'data.{segment}')
+
+    def _read(self, segment, offset, size):
+        # segment numbers are never reused, so open files stay valid
+        f = self.segments.get(segment)
+        if f is None:
+            f = self.segments[segment] = open(self._segment_path(segment), 'rb')
+        f.seek(offset)
+        return f.read(_RECORD.size + size)
+
+    def _append(self, header, digest, value):
+        segment = header[5] - 1
+        path = self._segment_path(segment)
+        if segment < 0 or not os.path.exists(path) or os.path.getsize(path) >= self.segment_bytes:
+            segment = header[5]
+            header[5] += 1
+            path = self._segment_path(segment)
+        with open(path, 'ab') as f:
+            offset = f.tell()
+            f.write(_RECORD.pack(digest, len(value)))
+            f.write(value)
+        return segment, offset
+
+    # ---------------------------------------
+    # eviction
+    # ---------------------------------------
+
+    def _evict(self, header, needed):
+        # evict down to 90% of the budgets so that it is not done on every write
+        max_bytes = min(self.max_bytes - needed, self.max_bytes * 9 // 10)
+        max_entries = self.max_entries * 9 // 10
+        for _, slot in sorted(self._entries(), key=lambda e: e[1][5]):
+            if header[4] <= max_bytes and header[3] <= max_entries:
+                break
+            header[3] -= 1
+            header[4] -= _RECORD.size + slot[4]
+            # slots move during backward-shift deletion
+            self._erase(self._find(slot[0])[0])
+        self._compact(header)
+
+    def _compact(self, header):
+        live = dict()
+        for _, slot in self._entries():
+            live[slot[1]] = live.get(slot[1], 0) + _RECORD.size + slot[4]
+        active = header[5] - 1
+        total = 0
+        for name in os.listdir(self.path):
+            if not name.startswith('data.'):
+                continue
+            segment = int(name[5:])
+            if segment not in live and segment != active:
+                self._unlink(segment)
+                continue
+            total += os.path.getsize(self._segment_path(segment))
+        # too much of the disk usage is dead: move the
+        # live entries of the emptiest segment forward
+        if total <= 2 * self.max_bytes:
+            return
+        candidates = [s for s in live if s != active]
+        if not candidates:
+            return
+        victim = min(candidates, key=lambda s: live[s] / os.path.getsize(self._segment_path(s)))
+        for i, slot in self._entries():
+            if slot[1] != victim:
+                continue
+            record = self._read(victim, slot[3], slot[4])
+            segment, offset = self._append(header, slot[0], record[_RECORD.size:])
+            self._set_slot(i, (slot[0], segment, 1, offset, slot[4], slot[5]))
+        self._unlink(victim)
+
+    def _unlink(self, segment):
+        f = self.segments.pop(segment, None)
+        if f is not None:
+            f.close()
+        os.unlink(self._segment_path(segment))
+
+    # ---------------------------------------
+    # interface
+    # ---------------------------------------
+
+    def get(self, key):
+        digest = hashlib.md5(key.encode('utf-8')).digest()
+        with self.lock:
+            self._open()
+            fcntl.flock(self.fd, fcntl.LOCK_SH)
+            try:
+                i, slot = self._find(digest)
+                if not slot[2]:
+                    return None
+                try:
+                    data = self._read(slot[1], slot[3], slot[4])
+                except FileNotFoundError:
+                    return None
+                if len(data) != _RECORD.size + slot[4] or _RECORD.unpack_from(data)[0] != digest:
+                    return None
+                self._set_slot(i, slot[:5] + (time.time_ns(),))
+                return data[_RECORD.size:]
+            finally:
+                fcntl.flock(self.fd, fcntl.LOCK_UN)
+
+    def put(self, key, value):
+        if _RECORD.size + len(value) > self.max_bytes:
+            return
+        digest = hashlib.md5(key.encode('utf-8')).digest()
+        with self.lock:
+            self._open()
+            fcntl.flock(self.fd, fcntl.LOCK_EX)
+            try:
+                header = self._header()
+                i, slot = self._find(digest)
+                if slot[2]:
+                    header[3] -= 1
+                    header[4] -= _RECORD.size + slot[4]
+                    self._erase(i)
+                needed = _RECORD.size + len(value)
+                if header[4] + needed > self.max_bytes or header[3] + 1 > self.max_entries:
+                    self._evict(header, needed)
+                segment, offset = self._append(header, digest, value)
+                i, _ = self._find(digest)
+                self._set_slot(i, (digest, segment, 1, offset, len(value), time.time_ns()))
+                header[3] += 1
+                header[4] += needed
+                self._set_header(header)
+                self.index.flush()
+            finally:
+                fcntl.flock(self.fd, fcntl.LOCK_UN)
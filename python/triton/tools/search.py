@@ -0,0 +1,139 @@
+import math
+import random
+
+# Search strategies of the autotuner.
+#
+# A strategy is called with:
+#  - `configs`: the configurations left after pruning,
+#  - `bench(configs, rep=100)`: compiles and benchmarks a list of configurations
+#    for about `rep` ms each, and returns a dict mapping each of them to its
+#    (median, 20th, 80th percentile) timing. Configurations that cannot run
+#    are timed as `inf`.
+#  - `estimate(config)`: the running time predicted by the performance model of
+#    the kernel, or None when it has none.
+# and returns the timings of the configurations it benchmarked. The autotuner
+# picks the fastest of them.
+
+
+def _budget(budget, num_configs):
+    # a float <= 1 is a fraction of the configurations
+    if isinstance(budget, float) and budget <= 1.0:
+        budget = int(num_configs * budget)
+    return max(1, min(budget, num_configs))
+
+
+class Exhaustive:
+    '''
+    Benchmarks every configuration
+    '''
+
+    def __call__(self, configs, bench, estimate):
+        return bench(configs)
+
+
+class SuccessiveHalving:
+    '''
+    Benchmarks every configuration with short runs of `min_rep` ms, keeps the
+    fastest `1 / eta` of them, and benchmarks the survivors again with `eta`
+    times more repetitions, until a single one is left or runs reach `max_rep` ms
+    '''
+
+    def __init__(self, min_rep=5, max_rep=100, eta=2):
+        assert eta > 1
+        self.min_rep = min_rep
+        self.max_rep = max_rep
+        self.eta = eta
+
+    def __call__(self, configs, bench, estimate):
+        timings = dict()
+        survivors = list(configs)
+        rep = self.min_rep
+        while True:
+            timings.update(bench(survivors, rep=rep))
+            if len(survivors) == 1 or rep >= self.max_rep:
+                break
+            survivors = sorted(survivors, key=timings.get)[:math.ceil(len(survivors) / self.eta)]
+            rep = min(rep * self.eta, self.max_rep)
+        # configurations eliminated early were timed less accurately:
+        # only the best survivor of the last round can be picked
+        best = min(survivors, key=timings.get)
+        ret = {best: timings[best]}
+        ret.update({c: max(t, timings[best]) for c, t in timings.items() if c is not best})
+        return ret
+
+
+class RandomSearch:
+    '''
+    Benchmarks `budget` configurations sampled uniformly. A float budget
+    <= 1 is a fraction of the configurations.
+    '''
+
+    def __init__(self, budget, seed=0):
+        self.budget = budget
+        self.seed = seed
+
+    def __call__(self, configs, bench, estimate):
+        budget = _budget(self.budget, len(configs))
+        return bench(random.Random(self.seed).sample(list(configs), budget))
+
+
+class LocalSearch:
+    '''
+    Hill climbing from the configuration with the best predicted running time
+    (the first one when the kernel has no performance model). At each step the
+    neighbors of the current best configuration -- those that differ from it in
+    a single parameter, set to the next smaller or larger value -- are
+    benchmarked, until none of them is faster or `budget` configurations were
+    benchmarked. A float budget <= 1 is a fraction of the configurations.
+    '''
+
+    def __init__(self, budget=1.0):
+        self.budget = budget
+
+    @staticmethod
+    def _params(config):
+        return dict(config.kwargs, num_warps=config.num_warps, num_stages=config.num_stages)
+
+    @staticmethod
+    def _neighbors(configs):
+        params = [LocalSearch._params(c) for c in configs]
+        names = sorted(set().union(*params))
+        # distinct values of every parameter, in order
+        values = dict()
+        for name in names:
+            values[name] = list(dict.fromkeys(p.get(name) for p in params))
+            try:
+                values[name].sort()
+            except TypeError:
+                pass
+        index = {frozenset(p.items()): c for p, c in zip(params, configs)}
+        neighbors = dict()
+        for p, c in zip(params, configs):
+            neighbors[c] = []
+            for name in names:
+                i = values[name].index(p.get(name))
+                for j in (i - 1, i + 1):
+                    if 0 <= j < len(values[name]):
+                        q = dict(p, **{name: values[name][j]})
+                        n = index.get(frozenset(q.items()))
+                        if n is not None:
+                            neighbors[c].append(n)
+        return neighbors
+
+    def __call__(self, configs, bench, estimate):
+        budget = _budget(self.budget, len(configs))
+        neighbors = self._neighbors(configs)
+        if estimate is not None:
+            configs = sorted(configs, key=estimate)
+        best = configs[0]
+        timings = bench([best])
+        while len(timings) < budget:
+            candidates = [n for n in neighbors[best] if n not in timings][:budget - len(timings)]
+            if not candidates:
+                break
+            timings.update(bench(candidates))
+            current = min(timings, key=timings.get)
+            if current is best:
+                break
+            best = current
+        return timings